@@ -0,0 +1,208 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <cairo.h>
+
+#include "polygon.h"
+#include "fitness.h"
+#include "raster.h"
+#include "bands.h"
+
+typedef struct band_worker 
+{
+    band_pool_t* pool;
+    int index;
+} band_worker_t;
+
+static void* run_band_worker( void* argument );
+static void evaluate_band( band_pool_t* pool, band_t* band );
+static cairo_surface_t* create_band_view( cairo_surface_t* surface, region_t* region );
+static void destroy_band_views( band_pool_t* pool, int originals );
+
+band_pool_t* initialize_band_pool( cairo_surface_t* original, int count ) 
+{
+    int i;
+    int height = cairo_image_surface_get_height( original );
+    band_pool_t* pool = malloc( sizeof( band_pool_t ) * sizeof( char ) );
+
+    // There is no use in bands thinner than a single row
+    count = count > height ? height : count;
+
+    pool->count    = count;
+    pool->bands    = malloc( sizeof( band_t ) * count );
+    pool->original = original;
+    pool->surface  = NULL;
+    pool->polygons = NULL;
+    pool->running  = 1;
+    pool->threads  = malloc( sizeof( pthread_t ) * count );
+
+    // Distribute the rows as evenly as possible
+    for( i=0; i<count; ++i ) 
+    {
+        pool->bands[i].region.x0 = 0;
+        pool->bands[i].region.x1 = cairo_image_surface_get_width( original );
+        pool->bands[i].region.y0 = height * i / count;
+        pool->bands[i].region.y1 = height * ( i + 1 ) / count;
+        pool->bands[i].original_view = create_band_view( original, &pool->bands[i].region );
+        pool->bands[i].surface_view  = NULL;
+    }
+
+    pthread_barrier_init( &pool->start, NULL, count );
+    pthread_barrier_init( &pool->done, NULL, count );
+
+    for( i=1; i<count; ++i ) 
+    {
+        band_worker_t* worker = malloc( sizeof( band_worker_t ) * sizeof( char ) );
+        worker->pool  = pool;
+        worker->index = i;
+        if ( pthread_create( &pool->threads[i], NULL, run_band_worker, worker ) != 0 ) 
+        {
+            printf( "Could not create band thread.\n" );
+            exit( EXIT_FAILURE );
+        }
+    }
+
+    return pool;
+}
+
+unsigned long long int evaluate_band_pool( band_pool_t* pool, cairo_surface_t* surface, polygons_t* polygons ) 
+{
+    int i;
+    unsigned long long int error = 0;
+
+    // The views of the render surface are kept as long as it is reused
+    if ( surface != pool->surface ) 
+    {
+        destroy_band_views( pool, 0 );
+        cairo_surface_flush( surface );
+        for( i=0; i<pool->count; ++i ) 
+        {
+            pool->bands[i].surface_view = create_band_view( surface, &pool->bands[i].region );
+        }
+        pool->surface = surface;
+    }
+    pool->polygons = polygons;
+
+    pthread_barrier_wait( &pool->start );
+    evaluate_band( pool, &pool->bands[0] );
+    pthread_barrier_wait( &pool->done );
+
+    // Summing up in band order keeps the result independent of the thread
+    // scheduling
+    for( i=0; i<pool->count; ++i ) 
+    {
+        error += pool->bands[i].error;
+    }
+
+    cairo_surface_mark_dirty( surface );
+    return error;
+}
+
+void free_band_pool( band_pool_t* pool ) 
+{
+    int i;
+
+    pool->running = 0;
+    pthread_barrier_wait( &pool->start );
+    for( i=1; i<pool->count; ++i ) 
+    {
+        pthread_join( pool->threads[i], NULL );
+    }
+
+    pthread_barrier_destroy( &pool->start );
+    pthread_barrier_destroy( &pool->done );
+
+    destroy_band_views( pool, 1 );
+    free( pool->bands );
+    free( pool->threads );
+    free( pool );
+}
+
+static void* run_band_worker( void* argument ) 
+{
+    band_worker_t* worker = (band_worker_t*)argument;
+    band_pool_t* pool = worker->pool;
+
+    while( 1 ) 
+    {
+        pthread_barrier_wait( &pool->start );
+        if ( !pool->running ) 
+        {
+            break;
+        }
+        evaluate_band( pool, &pool->bands[worker->index] );
+        pthread_barrier_wait( &pool->done );
+    }
+
+    free( worker );
+    return NULL;
+}
+
+static void evaluate_band( band_pool_t* pool, band_t* band ) 
+{
+    // The error is calculated on the raw band memory, which starts at the
+    // first row of the band
+    region_t local;
+    local.x0 = 0;
+    local.y0 = 0;
+    local.x1 = band->region.x1 - band->region.x0;
+    local.y1 = band->region.y1 - band->region.y0;
+
+    render_polygons_clipped( band->surface_view, pool->polygons, &band->region );
+    band->error = quadratic_error_region( band->original_view, band->surface_view, &local );
+}
+
+static cairo_surface_t* create_band_view( cairo_surface_t* surface, region_t* region ) 
+{
+    int stride = cairo_image_surface_get_stride( surface );
+    cairo_surface_t* view = cairo_image_surface_create_for_data( 
+        cairo_image_surface_get_data( surface ) + region->y0 * stride + region->x0 * 4,
+        CAIRO_FORMAT_ARGB32,
+        region->x1 - region->x0,
+        region->y1 - region->y0,
+        stride
+    );
+    if ( cairo_surface_status( view ) != CAIRO_STATUS_SUCCESS ) 
+    {
+        printf( "Could not create band surface.\n" );
+        exit( EXIT_FAILURE );
+    }
+    cairo_surface_set_device_offset( view, -region->x0, -region->y0 );
+    return view;
+}
+
+static void destroy_band_views( band_pool_t* pool, int originals ) 
+{
+    int i;
+    for( i=0; i<pool->count; ++i ) 
+    {
+        if ( pool->bands[i].surface_view != NULL ) 
+        {
+            cairo_surface_destroy( pool->bands[i].surface_view );
+            pool->bands[i].surface_view = NULL;
+        }
+        if ( originals ) 
+        {
+            cairo_surface_destroy( pool->bands[i].original_view );
+        }
+    }
+}
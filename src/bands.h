@@ -0,0 +1,59 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef BANDS_H
+#define BANDS_H
+
+#include <pthread.h>
+
+// One horizontal band of the canvas. The views are image surfaces sharing
+// the pixel memory of the band rows. Their device offset maps the canvas
+// coordinates onto the band, so every thread draws on its own surface.
+typedef struct band 
+{
+    region_t region;
+    cairo_surface_t* original_view;
+    cairo_surface_t* surface_view;
+    unsigned long long int error;
+} band_t;
+
+// Persistent worker pool rendering and scoring all bands of a candidate
+// concurrently. The calling thread handles the first band itself.
+typedef struct band_pool 
+{
+    int count;
+    band_t* bands;
+
+    cairo_surface_t* original;
+    cairo_surface_t* surface;
+    polygons_t* polygons;
+
+    pthread_t* threads;
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+    int running;
+} band_pool_t;
+
+band_pool_t* initialize_band_pool( cairo_surface_t* original, int count );
+
+unsigned long long int evaluate_band_pool( band_pool_t* pool, cairo_surface_t* surface, polygons_t* polygons );
+
+void free_band_pool( band_pool_t* pool );
+
+#endif
@@ -0,0 +1,414 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <cairo.h>
+
+#include "random.h"
+#include "polygon.h"
+#include "spatial.h"
+#include "incremental.h"
+#include "bands.h"
+#include "layers.h"
+#include "screen.h"
+#include "chain.h"
+#include "snapshot.h"
+#include "image.h"
+#include "bench.h"
+#include "batch.h"
+
+static void assign_output_directories( batch_t* batch, char* output_directory );
+static int compare_job_size( const void* a, const void* b );
+static int compare_names( const void* a, const void* b );
+static void* run_batch_worker( void* data );
+static void run_job( batch_t* batch, batch_job_t* job );
+static void write_batch_summary( batch_t* batch, char* filename );
+
+// Jobs are compared by size through this batch while sorting
+static batch_t* sorted_batch;
+
+int run_batch( char* source, char* output_directory, int workers, batch_settings_t* settings, rand_state_t* random ) 
+{
+    batch_t batch;
+    char** inputs;
+    char* filename;
+    pthread_t* threads;
+    int i, failed = 0;
+
+    batch.settings = settings;
+    batch.count    = read_batch_inputs( source, &inputs );
+    batch.jobs     = calloc( batch.count, sizeof( batch_job_t ) );
+    batch.order    = malloc( sizeof( int ) * batch.count );
+    batch.next     = 0;
+    batch.finished = 0;
+    pthread_mutex_init( &batch.lock, NULL );
+
+    if ( batch.count == 0 ) 
+    {
+        printf( "No input images found in %s.\n", source );
+        exit( EXIT_FAILURE );
+    }
+
+    // Streams are split in manifest order, so the result of a job does not
+    // depend on the scheduling
+    for( i=0; i<batch.count; ++i ) 
+    {
+        batch.jobs[i].input_file = inputs[i];
+        batch.jobs[i].status     = BATCH_PENDING;
+        if ( !read_png_size( inputs[i], &batch.jobs[i].width, &batch.jobs[i].height ) ) 
+        {
+            batch.jobs[i].width  = 0;
+            batch.jobs[i].height = 0;
+        }
+        rand_split( random, &batch.jobs[i].random );
+        batch.order[i] = i;
+    }
+    free( inputs );
+
+    if ( !make_directory( output_directory ) ) 
+    {
+        printf( "Could not create output directory %s.\n", output_directory );
+        exit( EXIT_FAILURE );
+    }
+    assign_output_directories( &batch, output_directory );
+
+    // Start with the largest images. The small ones fill the gaps at the
+    // end, so no worker idles while a large job is still running.
+    sorted_batch = &batch;
+    qsort( batch.order, batch.count, sizeof( int ), compare_job_size );
+
+    if ( workers < 1 ) 
+    {
+        workers = 1;
+    }
+    if ( workers > batch.count ) 
+    {
+        workers = batch.count;
+    }
+    printf( "Batch: %d images on %d workers\n", batch.count, workers );
+
+    threads = malloc( sizeof( pthread_t ) * workers );
+    for( i=0; i<workers; ++i ) 
+    {
+        if ( pthread_create( &threads[i], NULL, run_batch_worker, &batch ) != 0 ) 
+        {
+            printf( "Could not create batch worker thread.\n" );
+            exit( EXIT_FAILURE );
+        }
+    }
+    for( i=0; i<workers; ++i ) 
+    {
+        pthread_join( threads[i], NULL );
+    }
+    free( threads );
+
+    filename = malloc( sizeof( char ) * ( strlen( output_directory ) + strlen( BATCH_SUMMARY_FILENAME ) + 2 ) );
+    sprintf( filename, "%s/%s", output_directory, BATCH_SUMMARY_FILENAME );
+    write_batch_summary( &batch, filename );
+    printf( "Batch: %s written.\n", filename );
+    free( filename );
+
+    for( i=0; i<batch.count; ++i ) 
+    {
+        if ( batch.jobs[i].status != BATCH_DONE ) 
+        {
+            ++failed;
+        }
+        free( batch.jobs[i].input_file );
+        free( batch.jobs[i].output_directory );
+    }
+    free( batch.jobs );
+    free( batch.order );
+    pthread_mutex_destroy( &batch.lock );
+
+    return failed;
+}
+
+int read_batch_inputs( char* source, char*** inputs ) 
+{
+    struct stat info;
+    int count = 0, size = 16;
+
+    *inputs = malloc( sizeof( char* ) * size );
+
+    if ( stat( source, &info ) != 0 ) 
+    {
+        printf( "Could not open batch source %s.\n", source );
+        exit( EXIT_FAILURE );
+    }
+
+    if ( S_ISDIR( info.st_mode ) ) 
+    {
+        // Every png file of the directory, in name order
+        DIR* directory = opendir( source );
+        struct dirent* entry;
+        if ( directory == NULL ) 
+        {
+            printf( "Could not open batch directory %s.\n", source );
+            exit( EXIT_FAILURE );
+        }
+        while( ( entry = readdir( directory ) ) != NULL ) 
+        {
+            size_t length = strlen( entry->d_name );
+            if ( length < 5 || strcasecmp( entry->d_name + length - 4, ".png" ) != 0 ) 
+            {
+                continue;
+            }
+            if ( count == size ) 
+            {
+                size *= 2;
+                *inputs = realloc( *inputs, sizeof( char* ) * size );
+            }
+            (*inputs)[count] = malloc( sizeof( char ) * ( strlen( source ) + length + 2 ) );
+            sprintf( (*inputs)[count], "%s/%s", source, entry->d_name );
+            ++count;
+        }
+        closedir( directory );
+        qsort( *inputs, count, sizeof( char* ), compare_names );
+    }
+    else 
+    {
+        // A manifest with one path per line. Empty lines and lines starting
+        // with # are skipped.
+        char line[4096];
+        FILE* manifest = fopen( source, "r" );
+        if ( manifest == NULL ) 
+        {
+            printf( "Could not open batch manifest %s.\n", source );
+            exit( EXIT_FAILURE );
+        }
+        while( fgets( line, sizeof( line ), manifest ) != NULL ) 
+        {
+            size_t length = strlen( line );
+            while( length > 0 && ( line[length - 1] == '\n' || line[length - 1] == '\r' ) ) 
+            {
+                line[--length] = '\0';
+            }
+            if ( length == 0 || line[0] == '#' ) 
+            {
+                continue;
+            }
+            if ( count == size ) 
+            {
+                size *= 2;
+                *inputs = realloc( *inputs, sizeof( char* ) * size );
+            }
+            (*inputs)[count++] = strdup( line );
+        }
+        fclose( manifest );
+    }
+
+    return count;
+}
+
+static void assign_output_directories( batch_t* batch, char* output_directory ) 
+{
+    int i, j;
+
+    // Every job writes to a directory named after its input file. Clashing
+    // names get the manifest position appended.
+    for( i=0; i<batch->count; ++i ) 
+    {
+        char* name = strrchr( batch->jobs[i].input_file, '/' );
+        char* extension;
+        size_t length;
+
+        name      = name == NULL ? batch->jobs[i].input_file : name + 1;
+        extension = strrchr( name, '.' );
+        length    = extension == NULL || extension == name ? strlen( name ) : (size_t)( extension - name );
+
+        batch->jobs[i].output_directory = malloc( sizeof( char ) * ( strlen( output_directory ) + length + 16 ) );
+        sprintf( batch->jobs[i].output_directory, "%s/%.*s", output_directory, (int)length, name );
+
+        for( j=0; j<i; ++j ) 
+        {
+            if ( strcmp( batch->jobs[i].output_directory, batch->jobs[j].output_directory ) == 0 ) 
+            {
+                sprintf( batch->jobs[i].output_directory, "%s/%.*s-%d", output_directory, (int)length, name, i );
+                break;
+            }
+        }
+    }
+}
+
+int make_directory( char* path ) 
+{
+    return mkdir( path, 0755 ) == 0 || errno == EEXIST;
+}
+
+static int compare_job_size( const void* a, const void* b ) 
+{
+    batch_job_t* first  = &sorted_batch->jobs[*(int*)a];
+    batch_job_t* second = &sorted_batch->jobs[*(int*)b];
+    long long int difference = (long long int)second->width * second->height - (long long int)first->width * first->height;
+
+    if ( difference != 0 ) 
+    {
+        return difference > 0 ? 1 : -1;
+    }
+    return *(int*)a - *(int*)b;
+}
+
+static int compare_names( const void* a, const void* b ) 
+{
+    return strcmp( *(char**)a, *(char**)b );
+}
+
+static void* run_batch_worker( void* data ) 
+{
+    batch_t* batch = (batch_t*)data;
+
+    while( 1 ) 
+    {
+        batch_job_t* job;
+
+        pthread_mutex_lock( &batch->lock );
+        if ( batch->next == batch->count ) 
+        {
+            pthread_mutex_unlock( &batch->lock );
+            break;
+        }
+        job = &batch->jobs[batch->order[batch->next++]];
+        pthread_mutex_unlock( &batch->lock );
+
+        run_job( batch, job );
+
+        pthread_mutex_lock( &batch->lock );
+        ++batch->finished;
+        if ( job->status == BATCH_DONE ) 
+        {
+            printf( "Batch: %d/%d %s done in %.1fs (%llu)\n", batch->finished, batch->count, job->input_file, job->seconds, job->best_fitness );
+        }
+        else 
+        {
+            printf( "Batch: %d/%d %s failed\n", batch->finished, batch->count, job->input_file );
+        }
+        pthread_mutex_unlock( &batch->lock );
+    }
+
+    return NULL;
+}
+
+static void run_job( batch_t* batch, batch_job_t* job ) 
+{
+    batch_settings_t* settings = batch->settings;
+    cairo_surface_t* original;
+    cairo_surface_t* render_surface = NULL;
+    chain_t* chain;
+    struct timespec start, end;
+    unsigned int iteration = 0;
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+
+    if ( ( original = load_image_surface( job->input_file ) ) == NULL ) 
+    {
+        job->status = BATCH_FAILED;
+        return;
+    }
+    if ( !make_directory( job->output_directory ) ) 
+    {
+        cairo_surface_destroy( original );
+        job->status = BATCH_FAILED;
+        return;
+    }
+    job->width  = cairo_image_surface_get_width( original );
+    job->height = cairo_image_surface_get_height( original );
+
+    chain = initialize_chain( original, initialize_polygons( original, settings->polygon_count, settings->min_vertices, settings->max_vertices, &job->random ), settings->temperature, &job->random, &settings->options );
+
+    // The same schedule as a single chain run, snapshots are written by the
+    // worker itself
+    while( 1 ) 
+    {
+        int png = settings->png_write_iterations != 0 && iteration % settings->png_write_iterations == 0;
+        int svg = settings->svg_write_iterations != 0 && iteration % settings->svg_write_iterations == 0;
+
+        if ( png || svg ) 
+        {
+            char name[16];
+            sprintf( name, "%010u", iteration );
+            write_snapshot( original, &render_surface, update_chain_best( chain ), job->output_directory, name, png, svg );
+        }
+
+        step_chain( chain );
+
+        if( chain->temperature < settings->epsilon ) 
+        {
+            break;
+        }
+        chain->temperature *= settings->alpha;
+        ++iteration;
+    }
+
+    write_snapshot( original, &render_surface, update_chain_best( chain ), job->output_directory, "final", 1, 1 );
+    measure_chain( chain );
+
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    job->iterations   = iteration;
+    job->best_fitness = chain->exact_best_fitness;
+    job->seconds      = (double)( end.tv_sec - start.tv_sec ) + (double)( end.tv_nsec - start.tv_nsec ) / 1e9;
+    job->status       = BATCH_DONE;
+
+    free_chain( chain );
+    if ( render_surface != NULL ) 
+    {
+        cairo_surface_destroy( render_surface );
+    }
+    cairo_surface_destroy( original );
+}
+
+static void write_batch_summary( batch_t* batch, char* filename ) 
+{
+    FILE* file;
+    int i;
+
+    if ( ( file = fopen( filename, "w" ) ) == NULL ) 
+    {
+        printf( "Could not open batch summary %s.\n", filename );
+        exit( EXIT_FAILURE );
+    }
+
+    fprintf( file, "[\n" );
+    for( i=0; i<batch->count; ++i ) 
+    {
+        batch_job_t* job = &batch->jobs[i];
+        fprintf( file, "    {\"input\": " );
+        write_json_string( file, job->input_file );
+        fprintf( file, ", \"output\": " );
+        write_json_string( file, job->output_directory );
+        fprintf( file, ", \"status\": \"%s\", \"width\": %d, \"height\": %d, \"iterations\": %u, \"seconds\": %.3f, \"best_fitness\": %llu}%s\n",
+            job->status == BATCH_DONE ? "done" : "failed",
+            job->width,
+            job->height,
+            job->iterations,
+            job->seconds,
+            job->best_fitness,
+            i < batch->count - 1 ? "," : ""
+        );
+    }
+    fprintf( file, "]\n" );
+    fclose( file );
+}
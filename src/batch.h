@@ -0,0 +1,81 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <pthread.h>
+
+#define BATCH_SUMMARY_FILENAME "summary.json"
+
+enum 
+{
+    BATCH_PENDING,
+    BATCH_DONE,
+    BATCH_FAILED
+};
+
+// Annealing settings shared by all jobs of a batch
+typedef struct batch_settings 
+{
+    int polygon_count;
+    int min_vertices, max_vertices;
+    double temperature;
+    double alpha;
+    double epsilon;
+    int png_write_iterations;
+    int svg_write_iterations;
+    chain_options_t options;
+} batch_settings_t;
+
+// A single input image with its own random stream and results
+typedef struct batch_job 
+{
+    char* input_file;
+    char* output_directory;
+    int width, height; // 0 if the size could not be read
+    rand_state_t random;
+
+    int status;
+    unsigned int iterations;
+    unsigned long long int best_fitness;
+    double seconds;
+} batch_job_t;
+
+typedef struct batch 
+{
+    batch_settings_t* settings;
+
+    batch_job_t* jobs; // In manifest order
+    int count;
+
+    // Jobs ordered by decreasing size and the next one to be taken
+    int* order;
+    int next;
+    int finished;
+
+    pthread_mutex_t lock;
+} batch_t;
+
+int run_batch( char* source, char* output_directory, int workers, batch_settings_t* settings, rand_state_t* random );
+
+int read_batch_inputs( char* source, char*** inputs );
+int make_directory( char* path );
+
+#endif
@@ -0,0 +1,155 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <cairo.h>
+
+#include "random.h"
+#include "polygon.h"
+#include "spatial.h"
+#include "incremental.h"
+#include "bands.h"
+#include "layers.h"
+#include "screen.h"
+#include "chain.h"
+#include "bench.h"
+
+static double elapsed_seconds( struct timespec* start, struct timespec* end );
+
+void run_bench( cairo_surface_t* original, bench_t* bench, chain_options_t* options, char* filename ) 
+{
+    rand_state_t random;
+    chain_profile_t profile = { { 0 } };
+    chain_t* chain;
+    struct timespec start, end;
+    double seconds;
+    unsigned int i;
+    int phase;
+    FILE* file;
+
+    rand_seed( &random, bench->seed );
+    chain = initialize_chain( original, initialize_polygons( original, bench->polygon_count, bench->min_vertices, bench->max_vertices, &random ), bench->temperature, &random, options );
+    chain->profile = &profile;
+
+    // A fixed number of steps without any output, the temperature follows
+    // the usual schedule
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    for( i=0; i<bench->iterations; ++i ) 
+    {
+        step_chain( chain );
+        chain->temperature *= bench->alpha;
+    }
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    seconds = elapsed_seconds( &start, &end );
+    measure_chain( chain );
+
+    if ( ( file = fopen( filename, "w" ) ) == NULL ) 
+    {
+        printf( "Could not open benchmark file %s.\n", filename );
+        exit( EXIT_FAILURE );
+    }
+
+    fprintf( file, "{\n" );
+    fprintf( file, "    \"input\": " );
+    write_json_string( file, bench->input_file );
+    fprintf( file, ",\n" );
+    fprintf( file, "    \"width\": %d,\n", cairo_image_surface_get_width( original ) );
+    fprintf( file, "    \"height\": %d,\n", cairo_image_surface_get_height( original ) );
+    fprintf( file, "    \"polygons\": %d,\n", bench->polygon_count );
+    fprintf( file, "    \"min_vertices\": %d,\n", bench->min_vertices );
+    fprintf( file, "    \"max_vertices\": %d,\n", bench->max_vertices );
+    fprintf( file, "    \"seed\": %llu,\n", bench->seed );
+    fprintf( file, "    \"kernel\": \"%s\",\n", bench->kernel );
+    fprintf( file, "    \"backend\": \"%s\",\n", bench->backend );
+    fprintf( file, "    \"in_place\": %d,\n", options->in_place );
+    fprintf( file, "    \"incremental_tile_size\": %d,\n", options->incremental_tile_size );
+    fprintf( file, "    \"bands\": %d,\n", options->bands );
+    fprintf( file, "    \"layer_groups\": %d,\n", options->layer_groups );
+    fprintf( file, "    \"cull\": %d,\n", options->cull );
+    fprintf( file, "    \"screen\": %d,\n", options->screen );
+    fprintf( file, "    \"iterations\": %u,\n", bench->iterations );
+    fprintf( file, "    \"seconds\": %.6f,\n", seconds );
+    fprintf( file, "    \"iterations_per_second\": %.1f,\n", bench->iterations / seconds );
+    fprintf( file, "    \"ns_per_iteration\": %.1f,\n", seconds * 1e9 / bench->iterations );
+    fprintf( file, "    \"ns_per_phase\": {\n" );
+    for( phase=0; phase<CHAIN_PHASES; ++phase ) 
+    {
+        fprintf( file, "        \"%s\": %.1f%s\n", 
+            chain_phase_name( phase ), 
+            (double)profile.phase[phase] / bench->iterations,
+            phase < CHAIN_PHASES - 1 ? "," : ""
+        );
+    }
+    fprintf( file, "    },\n" );
+    fprintf( file, "    \"benefitial\": %u,\n", chain->benefitial );
+    fprintf( file, "    \"annealing\": %u,\n", chain->annealing );
+    if ( chain->spatial != NULL ) 
+    {
+        fprintf( file, "    \"polygons_queried\": %llu,\n", chain->spatial->queried );
+        fprintf( file, "    \"polygons_outside\": %llu,\n", chain->spatial->outside );
+        fprintf( file, "    \"polygons_culled\": %llu,\n", chain->spatial->culled );
+    }
+    if ( chain->screen != NULL ) 
+    {
+        fprintf( file, "    \"screened\": %llu,\n", chain->screen->screened );
+        fprintf( file, "    \"screen_rejected\": %llu,\n", chain->screen->rejected );
+        fprintf( file, "    \"screen_overruled\": %llu,\n", chain->screen->overruled );
+        fprintf( file, "    \"screen_audited\": %llu,\n", chain->screen->audited );
+        fprintf( file, "    \"screen_disagreed\": %llu,\n", chain->screen->disagreed );
+    }
+    fprintf( file, "    \"best_fitness\": %llu\n", chain->exact_best_fitness );
+    fprintf( file, "}\n" );
+    fclose( file );
+
+    printf( "Benchmark: %u iterations in %.3fs (%.1f/s, %.1fns per iteration)\n", 
+        bench->iterations, 
+        seconds, 
+        bench->iterations / seconds,
+        seconds * 1e9 / bench->iterations
+    );
+    printf( "Benchmark: %s written.\n", filename );
+
+    free_chain( chain );
+}
+
+void write_json_string( FILE* file, const char* string ) 
+{
+    fputc( '"', file );
+    for( ; *string != '\0'; ++string ) 
+    {
+        if ( *string == '"' || *string == '\\' ) 
+        {
+            fputc( '\\', file );
+        }
+        if ( (unsigned char)*string < 0x20 ) 
+        {
+            fprintf( file, "\\u%04x", *string );
+            continue;
+        }
+        fputc( *string, file );
+    }
+    fputc( '"', file );
+}
+
+static double elapsed_seconds( struct timespec* start, struct timespec* end ) 
+{
+    return (double)( end->tv_sec - start->tv_sec ) + (double)( end->tv_nsec - start->tv_nsec ) / 1e9;
+}
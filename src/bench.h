@@ -0,0 +1,45 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#define BENCH_DEFAULT_SEED 1
+#define BENCH_FILENAME "bench.json"
+
+// Everything describing a benchmark run
+typedef struct bench 
+{
+    char* input_file;
+    const char* kernel;
+    const char* backend;
+
+    int polygon_count;
+    int min_vertices, max_vertices;
+    double temperature;
+    double alpha;
+    unsigned int iterations;
+    unsigned long long int seed;
+} bench_t;
+
+void run_bench( cairo_surface_t* original, bench_t* bench, chain_options_t* options, char* filename );
+
+void write_json_string( FILE* file, const char* string );
+
+#endif
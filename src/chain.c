@@ -0,0 +1,423 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <cairo.h>
+
+#include "random.h"
+#include "polygon.h"
+#include "fitness.h"
+#include "raster.h"
+#include "spatial.h"
+#include "incremental.h"
+#include "bands.h"
+#include "layers.h"
+#include "screen.h"
+#include "chain.h"
+
+static void initialize_new_render_surface( cairo_surface_t* input, cairo_surface_t** render_surface );
+
+static unsigned long long int acceptance_limit( chain_t* chain, double randval );
+
+static const char* chain_phase_names[] = { "mutate", "copy", "render", "score", "accept" };
+
+static inline unsigned long long int profile_clock() 
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (unsigned long long int)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Add the time since the last phase ended to the given phase
+static inline void profile_phase( chain_t* chain, unsigned long long int* clock, int phase ) 
+{
+    unsigned long long int now;
+    if ( chain->profile == NULL ) 
+    {
+        return;
+    }
+    now = profile_clock();
+    chain->profile->phase[phase] += now - *clock;
+    *clock = now;
+}
+
+chain_t* initialize_chain( cairo_surface_t* original, polygons_t* polygons, double temperature, rand_state_t* random, chain_options_t* options ) 
+{
+    chain_t* chain = malloc( sizeof( chain_t ) * sizeof( char ) );
+
+    chain->original       = original;
+    chain->render_surface = NULL;
+    chain->incremental    = NULL;
+    chain->bands          = NULL;
+    chain->layers         = NULL;
+    chain->spatial        = NULL;
+    chain->screen         = NULL;
+    chain->polygons       = polygons;
+    chain->best_polygons  = copy_polygons( polygons );
+    chain->in_place       = options->in_place;
+    chain->best_pending   = 0;
+    chain->mutated        = 0;
+    chain->temperature    = temperature;
+    chain->benefitial     = 0;
+    chain->annealing      = 0;
+    chain->profile        = NULL;
+
+    rand_split( random, &chain->random );
+
+    initialize_new_render_surface( original, &chain->render_surface );
+    if ( options->bands > 1 ) 
+    {
+        chain->bands = initialize_band_pool( original, options->bands );
+        chain->current_fitness = evaluate_band_pool( chain->bands, chain->render_surface, polygons );
+    }
+    else 
+    {
+        render_polygons( chain->render_surface, polygons );
+        chain->current_fitness = quadratic_error( original, chain->render_surface );
+    }
+    chain->exact_current_fitness = chain->current_fitness;
+    chain->exact_best_fitness    = chain->current_fitness;
+
+    if ( options->incremental_tile_size > 0 ) 
+    {
+        chain->incremental = initialize_incremental( original, polygons, options->incremental_tile_size );
+    }
+    else if ( options->layer_groups > 0 ) 
+    {
+        // The candidates are scored on the composites, so the initial
+        // polygons are as well
+        chain->layers = initialize_layers( original, polygons->count, options->layer_groups );
+        chain->current_fitness = evaluate_layers( chain->layers, polygons, 0, ULLONG_MAX );
+    }
+    chain->best_fitness = chain->current_fitness;
+
+    // Only full evaluations are screened, the render surface still holds
+    // the initial polygons
+    if ( options->screen > 1 && chain->bands == NULL && chain->layers == NULL && chain->incremental == NULL ) 
+    {
+        chain->screen = initialize_screen( original, chain->render_surface, options->screen );
+    }
+
+    // Banded and layered evaluations draw every polygon of their part
+    if ( options->cull && chain->bands == NULL && chain->layers == NULL ) 
+    {
+        chain->spatial = initialize_spatial( cairo_image_surface_get_width( original ), cairo_image_surface_get_height( original ), polygons );
+        if ( chain->incremental != NULL ) 
+        {
+            chain->incremental->spatial = chain->spatial;
+        }
+    }
+
+    return chain;
+}
+
+int step_chain( chain_t* chain ) 
+{
+    unsigned long long int new_fitness;
+    polygons_t* new_polygons;       
+    polygon_t* previous_polygon;
+    int polygon_number;
+    int new_best = 0;
+    int accepted = 0;
+    double randval;
+    unsigned long long int limit;
+    unsigned long long int clock = chain->profile != NULL ? profile_clock() : 0;
+
+    // Create new evolution
+    if ( chain->in_place ) 
+    {
+        new_polygons     = chain->polygons;
+        polygon_number   = evolve_polygons( chain->polygons, &chain->undo, &chain->random );
+        previous_polygon = &chain->undo.polygon;
+    }
+    else 
+    {
+        new_polygons     = copy_polygons( chain->polygons );
+        profile_phase( chain, &clock, CHAIN_PHASE_COPY );
+        polygon_number   = evolve_polygons( new_polygons, NULL, &chain->random );
+        get_polygon( chain->polygons, polygon_number, &chain->undo.polygon );
+        previous_polygon = &chain->undo.polygon;
+    }
+    chain->mutated = polygon_number;
+
+    // Draw the random number of the acceptance test up front. It bounds the
+    // fitness which could still be accepted, so the evaluation may stop
+    // as soon as the error exceeds it.
+    randval = rand_double( &chain->random );
+    limit   = acceptance_limit( chain, randval );
+    if ( chain->spatial != NULL ) 
+    {
+        update_spatial( chain->spatial, new_polygons, polygon_number );
+    }
+    profile_phase( chain, &clock, CHAIN_PHASE_MUTATE );
+
+    if ( chain->incremental != NULL ) 
+    {
+        // Only redraw and rescore the area the mutation could change
+        new_fitness = evaluate_incremental( chain->incremental, new_polygons, polygon_number, previous_polygon, limit );
+        profile_phase( chain, &clock, CHAIN_PHASE_RENDER );
+    }
+    else if ( chain->layers != NULL ) 
+    {
+        // Only redraw the group of the mutated polygon between the cached
+        // composites below and above it
+        new_fitness = evaluate_layers( chain->layers, new_polygons, polygon_number, limit );
+        profile_phase( chain, &clock, CHAIN_PHASE_RENDER );
+    }
+    else if ( chain->bands != NULL ) 
+    {
+        // Every band clears and redraws its part of the persistent surface
+        new_fitness = evaluate_band_pool( chain->bands, chain->render_surface, new_polygons );
+        profile_phase( chain, &clock, CHAIN_PHASE_RENDER );
+    }
+    else 
+    {
+        reset_render_surface( chain->original, &chain->render_surface, chain->in_place );
+        if ( chain->spatial != NULL ) 
+        {
+            render_spatial( chain->spatial, chain->render_surface, new_polygons );
+        }
+        else 
+        {
+            render_polygons( chain->render_surface, new_polygons );
+        }
+        profile_phase( chain, &clock, CHAIN_PHASE_RENDER );
+        if ( chain->screen != NULL ) 
+        {
+            // Only score all rows if the sampled ones do not rule the
+            // candidate out
+            new_fitness = evaluate_screen( chain->screen, chain->original, chain->render_surface, chain->current_fitness, limit );
+        }
+        else 
+        {
+            new_fitness = quadratic_error_bounded( chain->original, chain->render_surface, limit );
+        }
+        profile_phase( chain, &clock, CHAIN_PHASE_SCORE );
+    }
+
+    // Store polygons with the best fitness found so far
+    if ( new_fitness <= chain->best_fitness ) 
+    {
+        // A new best is always accepted below. Working in place it is
+        // only copied once the polygons are about to move away from it.
+        if ( !chain->in_place ) 
+        {
+            free_polygons( chain->best_polygons );
+            chain->best_polygons = copy_polygons( new_polygons );
+            profile_phase( chain, &clock, CHAIN_PHASE_COPY );
+        }
+        chain->best_fitness = new_fitness;
+        new_best = 1;
+    }
+
+    // If the new evolution is better than the old one the old one will die
+    // and the new one will be taken further
+    if ( new_fitness < chain->current_fitness ) 
+    {
+        ++chain->benefitial;
+        accepted = 1;
+    }
+    else 
+    {
+        // Only change to worse evolution with falling probability based on
+        // the iteration and the fitness difference
+        // Small changes in fitness are more likely to be accepted. A fitness
+        // above the limit may be a partial sum, it is rejected either way.
+        long long int fitness_difference           = new_fitness - chain->current_fitness;
+        double fitness_temperature_division = ( fitness_difference / ( chain->temperature * 10.0 ) );
+        double pb                           = exp( (double)(-1) * fitness_temperature_division );            
+        if( randval < pb ) 
+        {
+            ++chain->annealing;
+            accepted = 1;
+        }
+    }
+
+    if ( accepted ) 
+    {
+        if ( chain->incremental != NULL ) 
+        {
+            accept_incremental( chain->incremental );
+        }
+        if ( chain->layers != NULL ) 
+        {
+            accept_layers( chain->layers, polygon_number );
+        }
+        if ( chain->screen != NULL ) 
+        {
+            accept_screen( chain->screen );
+        }
+        if ( chain->in_place ) 
+        {
+            // Leaving a best state which has not been copied yet. It
+            // equals the working polygons without the current mutation.
+            if ( chain->best_pending && !new_best ) 
+            {
+                copy_polygons_into( chain->best_polygons, chain->polygons );
+                undo_polygons( chain->best_polygons, &chain->undo );
+            }
+            chain->best_pending = new_best;
+        }
+        else 
+        {
+            free_polygons( chain->polygons );
+            chain->polygons = new_polygons;
+        }
+        chain->current_fitness = new_fitness;
+    }
+    else 
+    {
+        // Don't accept the new change
+        if ( chain->incremental != NULL ) 
+        {
+            reject_incremental( chain->incremental );
+        }
+        if ( chain->spatial != NULL ) 
+        {
+            revert_spatial( chain->spatial );
+        }
+        if ( chain->in_place ) 
+        {
+            undo_polygons( chain->polygons, &chain->undo );
+        }
+        else 
+        {
+            free_polygons( new_polygons );
+        }
+    }
+    profile_phase( chain, &clock, CHAIN_PHASE_ACCEPT );
+
+    return accepted;
+}
+
+polygons_t* update_chain_best( chain_t* chain ) 
+{
+    // Bring the lazily tracked best polygons up to date
+    if ( chain->best_pending ) 
+    {
+        copy_polygons_into( chain->best_polygons, chain->polygons );
+        chain->best_pending = 0;
+    }
+    return chain->best_polygons;
+}
+
+void measure_chain( chain_t* chain ) 
+{
+    // Every other evaluation is exact already. The render surface is not
+    // used by layered evaluations, the annealing is left untouched.
+    if ( chain->layers == NULL ) 
+    {
+        chain->exact_current_fitness = chain->current_fitness;
+        chain->exact_best_fitness    = chain->best_fitness;
+        return;
+    }
+
+    reset_render_surface( chain->original, &chain->render_surface, 1 );
+    render_polygons( chain->render_surface, chain->polygons );
+    chain->exact_current_fitness = quadratic_error( chain->original, chain->render_surface );
+
+    reset_render_surface( chain->original, &chain->render_surface, 1 );
+    render_polygons( chain->render_surface, update_chain_best( chain ) );
+    chain->exact_best_fitness = quadratic_error( chain->original, chain->render_surface );
+}
+
+void free_chain( chain_t* chain ) 
+{
+    free_polygons( chain->polygons );
+    free_polygons( chain->best_polygons );
+    if ( chain->incremental != NULL ) 
+    {
+        free_incremental( chain->incremental );
+    }
+    if ( chain->bands != NULL ) 
+    {
+        free_band_pool( chain->bands );
+    }
+    if ( chain->layers != NULL ) 
+    {
+        free_layers( chain->layers );
+    }
+    if ( chain->spatial != NULL ) 
+    {
+        free_spatial( chain->spatial );
+    }
+    if ( chain->screen != NULL ) 
+    {
+        free_screen( chain->screen );
+    }
+    cairo_surface_destroy( chain->render_surface );
+    free( chain );
+}
+
+const char* chain_phase_name( int phase ) 
+{
+    return chain_phase_names[phase];
+}
+
+void reset_render_surface( cairo_surface_t* input, cairo_surface_t** render_surface, int reuse ) 
+{
+    cairo_t* cr;
+
+    if ( !reuse || *render_surface == NULL ) 
+    {
+        initialize_new_render_surface( input, render_surface );
+        return;
+    }
+
+    // Clear the existing surface instead of allocating a new one
+    cr = cairo_create( *render_surface );
+    cairo_set_operator( cr, CAIRO_OPERATOR_CLEAR );
+    cairo_paint( cr );
+    cairo_destroy( cr );
+}
+
+static void initialize_new_render_surface( cairo_surface_t* input, cairo_surface_t** render_surface ) 
+{
+    if ( *render_surface != NULL ) 
+    {
+        cairo_surface_destroy( *render_surface );
+    }
+    
+    // Retrieve input metadata and create render_surface
+    *render_surface = cairo_surface_create_similar( 
+        input,
+        CAIRO_CONTENT_COLOR_ALPHA,
+        cairo_image_surface_get_width( input ),
+        cairo_image_surface_get_height( input )
+    );
+    if ( cairo_surface_status( *render_surface ) != CAIRO_STATUS_SUCCESS ) 
+    {
+        printf( "Could not create render surface.\n" );
+        exit( EXIT_FAILURE );
+    }
+}
+
+static unsigned long long int acceptance_limit( chain_t* chain, double randval ) 
+{
+    // exp( -d / ( 10 T ) ) > randval holds exactly for d < -10 T ln( randval )
+    double difference = randval > 0.0 ? -10.0 * chain->temperature * log( randval ) : HUGE_VAL;
+    if ( difference >= (double)( ULLONG_MAX - chain->current_fitness ) ) 
+    {
+        return ULLONG_MAX;
+    }
+    return chain->current_fitness + (unsigned long long int)difference;
+}
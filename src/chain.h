@@ -0,0 +1,124 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef CHAIN_H
+#define CHAIN_H
+
+// Evaluation strategies of a chain
+typedef struct chain_options 
+{
+    // Mutate the polygons in place and undo rejected mutations, instead of
+    // working on a fresh copy each step
+    int in_place;
+
+    // Tile size of the incremental evaluation error cache (0 if disabled)
+    int incremental_tile_size;
+
+    // Number of bands full evaluations are split into (0 or 1 if disabled)
+    int bands;
+
+    // Number of polygon groups with cached composites (0 if disabled)
+    int layer_groups;
+
+    // Skip polygons outside of the evaluated region or provably invisible
+    // in full and incremental evaluations
+    int cull;
+
+    // Row stride of the sample full evaluations are screened on (0 or 1 if
+    // disabled)
+    int screen;
+} chain_options_t;
+
+// Phases of a step measured by a chain profile. Incremental, layered and
+// banded evaluations score while rendering, their time is counted as
+// render.
+enum 
+{
+    CHAIN_PHASE_MUTATE,
+    CHAIN_PHASE_COPY,
+    CHAIN_PHASE_RENDER,
+    CHAIN_PHASE_SCORE,
+    CHAIN_PHASE_ACCEPT,
+    CHAIN_PHASES
+};
+
+// Nanoseconds spent in every phase of the profiled steps
+typedef struct chain_profile 
+{
+    unsigned long long int phase[CHAIN_PHASES];
+} chain_profile_t;
+
+// A single simulated annealing chain with its own polygons, surfaces and
+// counters. The temperature is lowered by the caller.
+typedef struct chain 
+{
+    cairo_surface_t* original;
+    cairo_surface_t* render_surface;
+    incremental_t* incremental; // NULL if disabled
+    band_pool_t* bands;         // NULL if disabled
+    layers_t* layers;           // NULL if disabled
+    spatial_t* spatial;         // NULL if disabled
+    screen_t* screen;           // NULL if disabled
+
+    polygons_t* polygons;
+    polygons_t* best_polygons;
+
+    int in_place;
+    int best_pending;
+    polygon_undo_t undo;
+
+    // Polygon changed by the last step, its previous state is kept in the
+    // undo information
+    int mutated;
+
+    unsigned long long int current_fitness;
+    unsigned long long int best_fitness;
+
+    // Errors of the current and the best polygons drawn at once, as of the
+    // last measure_chain. Layered evaluations compare the fitness values
+    // of their re-blended composites instead, which differ slightly.
+    unsigned long long int exact_current_fitness;
+    unsigned long long int exact_best_fitness;
+
+    double temperature;
+
+    unsigned int benefitial;
+    unsigned int annealing;
+
+    // Random stream of the mutations and the acceptance test
+    rand_state_t random;
+
+    chain_profile_t* profile; // NULL if disabled
+} chain_t;
+
+chain_t* initialize_chain( cairo_surface_t* original, polygons_t* polygons, double temperature, rand_state_t* random, chain_options_t* options );
+
+int step_chain( chain_t* chain );
+
+polygons_t* update_chain_best( chain_t* chain );
+
+void measure_chain( chain_t* chain );
+
+void free_chain( chain_t* chain );
+
+const char* chain_phase_name( int phase );
+
+void reset_render_surface( cairo_surface_t* input, cairo_surface_t** render_surface, int reuse );
+
+#endif
@@ -0,0 +1,257 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cairo.h>
+
+#include "random.h"
+#include "polygon.h"
+#include "spatial.h"
+#include "incremental.h"
+#include "bands.h"
+#include "layers.h"
+#include "screen.h"
+#include "chain.h"
+#include "growth.h"
+#include "checkpoint.h"
+
+#define CHECKPOINT_BYTE_ORDER 0x01020304
+
+static int write_genome( FILE* file, polygons_t* polygons );
+
+int write_checkpoint( char* filename, chain_t* chain, growth_t* growth, rand_state_t* master, unsigned int iteration, int level, int levels ) 
+{
+    checkpoint_header_t header;
+    polygons_t* best = update_chain_best( chain );
+    char* temporary = malloc( sizeof( char ) * ( strlen( filename ) + 5 ) );
+    FILE* file;
+    int written;
+
+    memset( &header, 0, sizeof( checkpoint_header_t ) );
+    memcpy( header.magic, CHECKPOINT_MAGIC, 4 );
+    header.version         = CHECKPOINT_VERSION;
+    header.byte_order      = CHECKPOINT_BYTE_ORDER;
+    header.polygon_size    = POLYGON_GENOME_SIZE( chain->polygons->max_vertices );
+    header.polygon_count   = chain->polygons->count;
+    header.min_vertices    = chain->polygons->min_vertices;
+    header.max_vertices    = chain->polygons->max_vertices;
+    header.width           = chain->polygons->original_width;
+    header.height          = chain->polygons->original_height;
+    header.level           = level;
+    header.levels          = levels;
+    header.iteration       = iteration;
+    header.benefitial      = chain->benefitial;
+    header.annealing       = chain->annealing;
+    header.temperature     = chain->temperature;
+    header.current_fitness = chain->current_fitness;
+    header.best_fitness    = chain->best_fitness;
+    header.exact_current_fitness = chain->exact_current_fitness;
+    header.exact_best_fitness    = chain->exact_best_fitness;
+    header.random          = chain->random;
+    header.master          = *master;
+    if ( chain->screen != NULL ) 
+    {
+        header.screen_phase     = chain->screen->phase;
+        header.screened         = chain->screen->screened;
+        header.screen_rejected  = chain->screen->rejected;
+        header.screen_passed    = chain->screen->passed;
+        header.screen_overruled = chain->screen->overruled;
+        header.screen_audited   = chain->screen->audited;
+        header.screen_disagreed = chain->screen->disagreed;
+    }
+    if ( growth != NULL ) 
+    {
+        header.growth_reference_fitness   = growth->reference_fitness;
+        header.growth_reference_iteration = growth->reference_iteration;
+        header.growth_added               = growth->added;
+    }
+
+    // Write to a temporary file first and move it over the old checkpoint,
+    // so an interrupted write never destroys the last valid state
+    sprintf( temporary, "%s.tmp", filename );
+    if ( ( file = fopen( temporary, "wb" ) ) == NULL ) 
+    {
+        printf( "Could not open checkpoint file %s.\n", temporary );
+        free( temporary );
+        return 0;
+    }
+    written = fwrite( &header, sizeof( checkpoint_header_t ), 1, file ) == 1
+           && write_genome( file, chain->polygons )
+           && write_genome( file, best )
+           && fflush( file ) == 0
+           && fsync( fileno( file ) ) == 0;
+    written = fclose( file ) == 0 && written;
+
+    if ( !written || rename( temporary, filename ) != 0 ) 
+    {
+        printf( "Could not write checkpoint file %s.\n", filename );
+        unlink( temporary );
+        free( temporary );
+        return 0;
+    }
+
+    free( temporary );
+    return 1;
+}
+
+checkpoint_t* read_checkpoint( char* filename ) 
+{
+    checkpoint_t* checkpoint;
+    checkpoint_header_t* header;
+    polygons_t view;
+    struct stat info;
+    char* data;
+    size_t expected;
+    int fd;
+
+    // Read the whole file at once and validate it afterwards
+    if ( ( fd = open( filename, O_RDONLY ) ) == -1 || fstat( fd, &info ) != 0 ) 
+    {
+        printf( "Could not open checkpoint file %s.\n", filename );
+        exit( EXIT_FAILURE );
+    }
+    data = malloc( sizeof( char ) * ( info.st_size + 1 ) );
+    if ( read( fd, data, info.st_size ) != (ssize_t)info.st_size ) 
+    {
+        printf( "Could not read checkpoint file %s.\n", filename );
+        exit( EXIT_FAILURE );
+    }
+    close( fd );
+
+    header = (checkpoint_header_t*)data;
+    if ( (size_t)info.st_size < sizeof( checkpoint_header_t ) || memcmp( header->magic, CHECKPOINT_MAGIC, 4 ) != 0 ) 
+    {
+        printf( "%s is not a checkpoint file.\n", filename );
+        exit( EXIT_FAILURE );
+    }
+    if ( header->version != CHECKPOINT_VERSION 
+      || header->byte_order != CHECKPOINT_BYTE_ORDER 
+      || header->min_vertices < POLYGON_MIN_VERTICES 
+      || header->max_vertices > POLYGON_MAX_VERTICES 
+      || header->min_vertices > header->max_vertices 
+      || header->polygon_size != POLYGON_GENOME_SIZE( header->max_vertices ) ) 
+    {
+        printf( "Checkpoint file %s was written by an incompatible version.\n", filename );
+        exit( EXIT_FAILURE );
+    }
+    if ( header->polygon_count <= 0 ) 
+    {
+        printf( "Checkpoint file %s is truncated.\n", filename );
+        exit( EXIT_FAILURE );
+    }
+    // Computed in size_t, a corrupt count must not wrap around
+    expected = sizeof( checkpoint_header_t ) + 2 * (size_t)header->polygon_size * (size_t)header->polygon_count;
+    if ( (size_t)info.st_size != expected ) 
+    {
+        printf( "Checkpoint file %s is truncated.\n", filename );
+        exit( EXIT_FAILURE );
+    }
+
+    checkpoint = malloc( sizeof( checkpoint_t ) * sizeof( char ) );
+    memcpy( &checkpoint->header, header, sizeof( checkpoint_header_t ) );
+
+    view.original_width  = header->width;
+    view.original_height = header->height;
+    map_polygons( &view, data + sizeof( checkpoint_header_t ), header->polygon_count, header->max_vertices );
+    view.min_vertices    = header->min_vertices;
+    checkpoint->polygons = copy_polygons( &view );
+    map_polygons( &view, data + sizeof( checkpoint_header_t ) + header->polygon_size * header->polygon_count, header->polygon_count, header->max_vertices );
+    view.min_vertices    = header->min_vertices;
+    checkpoint->best_polygons = copy_polygons( &view );
+
+    free( data );
+    return checkpoint;
+}
+
+chain_t* resume_chain( cairo_surface_t* original, checkpoint_t* checkpoint, rand_state_t* master, chain_options_t* options ) 
+{
+    chain_t* chain;
+
+    if ( checkpoint->header.width != cairo_image_surface_get_width( original ) 
+      || checkpoint->header.height != cairo_image_surface_get_height( original ) ) 
+    {
+        printf( "The checkpoint does not match the size of the input image.\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    // The chain takes over and evaluates the current polygons, everything
+    // else is restored on top of it
+    chain = initialize_chain( original, checkpoint->polygons, checkpoint->header.temperature, master, options );
+    checkpoint->polygons = NULL;
+
+    copy_polygons_into( chain->best_polygons, checkpoint->best_polygons );
+    chain->current_fitness = checkpoint->header.current_fitness;
+    chain->best_fitness    = checkpoint->header.best_fitness;
+    chain->exact_current_fitness = checkpoint->header.exact_current_fitness;
+    chain->exact_best_fitness    = checkpoint->header.exact_best_fitness;
+    chain->benefitial      = checkpoint->header.benefitial;
+    chain->annealing       = checkpoint->header.annealing;
+
+    chain->random          = checkpoint->header.random;
+    *master                = checkpoint->header.master;
+
+    // The audits depend on the number of rejections so far
+    if ( chain->screen != NULL ) 
+    {
+        chain->screen->phase     = checkpoint->header.screen_phase % chain->screen->stride;
+        chain->screen->screened  = checkpoint->header.screened;
+        chain->screen->rejected  = checkpoint->header.screen_rejected;
+        chain->screen->passed    = checkpoint->header.screen_passed;
+        chain->screen->overruled = checkpoint->header.screen_overruled;
+        chain->screen->audited   = checkpoint->header.screen_audited;
+        chain->screen->disagreed = checkpoint->header.screen_disagreed;
+    }
+
+    return chain;
+}
+
+void resume_growth( growth_t* growth, checkpoint_t* checkpoint ) 
+{
+    // Continue the observation window instead of starting a new one at
+    // the resumed iteration
+    growth->reference_fitness   = checkpoint->header.growth_reference_fitness;
+    growth->reference_iteration = checkpoint->header.growth_reference_iteration;
+    growth->added               = checkpoint->header.growth_added;
+}
+
+void free_checkpoint( checkpoint_t* checkpoint ) 
+{
+    if ( checkpoint->polygons != NULL ) 
+    {
+        free_polygons( checkpoint->polygons );
+    }
+    free_polygons( checkpoint->best_polygons );
+    free( checkpoint );
+}
+
+static int write_genome( FILE* file, polygons_t* polygons ) 
+{
+    // Same layout as the in memory genome block
+    size_t slots = (size_t)polygons->count * polygons->max_vertices;
+    size_t count = (size_t)polygons->count;
+    return fwrite( polygons->x, sizeof( unsigned short ), slots, file ) == slots
+        && fwrite( polygons->y, sizeof( unsigned short ), slots, file ) == slots
+        && fwrite( polygons->color, sizeof( unsigned char ), count * 4, file ) == count * 4
+        && fwrite( polygons->vertices, sizeof( unsigned char ), count, file ) == count;
+}
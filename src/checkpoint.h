@@ -0,0 +1,96 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "random.h"
+
+#define CHECKPOINT_VERSION 7
+#define CHECKPOINT_MAGIC "EVCP"
+#define CHECKPOINT_FILENAME "checkpoint.bin"
+#define CHECKPOINT_DEFAULT_ITERATIONS 100000
+
+// Fixed size file header. It is followed by the current and the best
+// polygons of the chain, stored as packed genomes in native byte order.
+typedef struct checkpoint_header 
+{
+    char magic[4];
+    unsigned int version;
+    unsigned int byte_order;   // 0x01020304 as written by the machine
+    unsigned int polygon_size; // POLYGON_GENOME_SIZE( max_vertices )
+    int polygon_count;
+    int min_vertices, max_vertices;
+    int width, height;         // Canvas of the stored polygons
+
+    // Pyramid level the chain is annealed on
+    int level;
+    int levels;
+
+    unsigned int iteration;
+    unsigned int benefitial;
+    unsigned int annealing;
+    double temperature;
+    unsigned long long current_fitness;
+    unsigned long long best_fitness;
+
+    // Errors of the polygons drawn at once, as measured before writing.
+    // They only differ from the values above for layered evaluations.
+    unsigned long long exact_current_fitness;
+    unsigned long long exact_best_fitness;
+
+    // Random stream of the chain and the one new chains are split from
+    rand_state_t random;
+    rand_state_t master;
+
+    // Row screening state (zero if disabled). The row errors are derived
+    // from the polygons again.
+    int screen_phase;
+    unsigned long long screened;
+    unsigned long long screen_rejected;
+    unsigned long long screen_passed;
+    unsigned long long screen_overruled;
+    unsigned long long screen_audited;
+    unsigned long long screen_disagreed;
+
+    // Growth state (zero if disabled): start of the current observation
+    // window and the number of polygons added so far
+    unsigned long long growth_reference_fitness;
+    unsigned int growth_reference_iteration;
+    unsigned int growth_added;
+} checkpoint_header_t;
+
+typedef struct checkpoint 
+{
+    checkpoint_header_t header;
+    polygons_t* polygons;
+    polygons_t* best_polygons;
+} checkpoint_t;
+
+int write_checkpoint( char* filename, chain_t* chain, growth_t* growth, rand_state_t* master, unsigned int iteration, int level, int levels );
+
+checkpoint_t* read_checkpoint( char* filename );
+
+chain_t* resume_chain( cairo_surface_t* original, checkpoint_t* checkpoint, rand_state_t* master, chain_options_t* options );
+
+void resume_growth( growth_t* growth, checkpoint_t* checkpoint );
+
+void free_checkpoint( checkpoint_t* checkpoint );
+
+#endif
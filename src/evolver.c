@@ -20,6 +20,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <string.h>
 #include <math.h>
 
@@ -27,35 +28,145 @@
 
 #include "random.h"
 #include "polygon.h"
-
-
-#ifndef ULLONG_MAX
-    #define ULLONG_MAX 18446744073709551615ULL
-#endif
-
-static unsigned long long int quadratic_error( cairo_surface_t* original, cairo_surface_t* destination );
-static void initialize_new_render_surface( cairo_surface_t* input, cairo_surface_t** render_surface );
+#include "fitness.h"
+#include "raster.h"
+#include "spatial.h"
+#include "incremental.h"
+#include "bands.h"
+#include "layers.h"
+#include "screen.h"
+#include "chain.h"
+#include "growth.h"
+#include "tempering.h"
+#include "speculative.h"
+#include "pyramid.h"
+#include "snapshot.h"
+#include "checkpoint.h"
+#include "bench.h"
+#include "telemetry.h"
+#include "image.h"
+#include "batch.h"
+#include "sequence.h"
+#include "island.h"
+#include "journal.h"
+
+// Long only commandline options
+#define OPTION_RESUME             256
+#define OPTION_SEED               257
+#define OPTION_BENCH              258
+#define OPTION_TELEMETRY          259
+#define OPTION_TELEMETRY_FORMAT   260
+#define OPTION_TELEMETRY_INTERVAL 261
+#define OPTION_BATCH              262
+#define OPTION_JOBS               263
+#define OPTION_SEQUENCE           264
+#define OPTION_WARM_TEMPERATURE   265
+#define OPTION_WARM_ITERATIONS    266
+#define OPTION_ISLAND             267
+#define OPTION_ISLAND_SLOTS       268
+#define OPTION_ISLAND_INTERVAL    269
+#define OPTION_ISLAND_POLICY      270
+#define OPTION_JOURNAL            271
+#define OPTION_JOURNAL_KEYFRAMES  272
+#define OPTION_GROW               273
+#define OPTION_GROW_STALL         274
+
+
+static int snapshot_due( unsigned int previous_iteration, unsigned int iteration, int every );
+static void record_chain_telemetry( telemetry_t* telemetry, chain_t* chain, unsigned int iteration, int exact );
+static void record_tempering_telemetry( telemetry_t* telemetry, tempering_t* tempering, unsigned int iteration, int exact );
 static void show_usage();
 
 
 int main( int argc, char** argv ) 
 {
-    // Drawing and original cairo surfaces
-    cairo_surface_t* input_surface  = NULL;
-    cairo_surface_t* render_surface = NULL;
-
-    // Polygon structs
-    polygons_t* polygons      = NULL;
-    polygons_t* best_polygons = NULL;
-
-    // Iteration counters
-    unsigned int iteration  = 0;
-    unsigned int benefitial = 0;
-    unsigned int annealing  = 0;
-
-    // Fitness levels
-    unsigned long long int current_fitness = ULLONG_MAX;
-    unsigned long long int best_fitness    = ULLONG_MAX;
+    // Original cairo surface
+    cairo_surface_t* input_surface = NULL;
+
+    // Background thread rendering and writing the snapshots
+    snapshot_writer_t* writer = NULL;
+
+    // Annealing chain, or the replicas in parallel tempering mode
+    chain_t* chain             = NULL;
+    tempering_t* tempering     = NULL;
+    speculation_t* speculation = NULL;
+
+    // Evaluation strategies of the chains (all disabled by default)
+    chain_options_t options = { 0, 0, 0, 0, 0, 0 };
+
+    // Parallel tempering replica count (0 for a single chain), temperature
+    // ratio between neighbouring replicas and steps between exchanges
+    int replicas       = 0;
+    double ladder      = TEMPERING_DEFAULT_LADDER;
+    int exchange_steps = TEMPERING_DEFAULT_STEPS;
+
+    // Number of candidates evaluated concurrently per speculative step (0
+    // for sequential proposals)
+    int speculative = 0;
+
+    // Number of resolution levels to anneal on, coarsest first (1 to work
+    // on the original resolution only)
+    int pyramid_levels = 1;
+
+    // Error kernel to use (NULL to select the best one the cpu supports)
+    char* kernel_name = NULL;
+
+    // Polygon rendering backend (NULL for cairo)
+    char* backend_name = NULL;
+
+    // Random number generator all other streams are split from, and its
+    // seed
+    rand_state_t random;
+    unsigned long long int seed = rand_default_seed();
+    int seeded = 0;
+
+    // Number of iterations to benchmark (0 for a normal run)
+    unsigned int bench_iterations = 0;
+
+    // Progress records, optionally written to a file in the given format
+    telemetry_t* telemetry    = NULL;
+    char* telemetry_file      = NULL;
+    char* telemetry_format    = NULL;
+    double telemetry_interval = TELEMETRY_DEFAULT_INTERVAL;
+
+    // Manifest or directory of images to process in batch mode (NULL for
+    // a single image) and the number of concurrent jobs
+    char* batch_source = NULL;
+    int batch_workers  = sysconf( _SC_NPROCESSORS_ONLN );
+
+    // Manifest or directory of animation frames (NULL for a single image),
+    // and the schedule of the warm started frames (0 for the defaults)
+    char* sequence_source        = NULL;
+    double warm_temperature      = 0;
+    unsigned int warm_iterations = 0;
+
+    // Shared memory segment to exchange the best genomes with other
+    // processes through (NULL for an isolated run), its slot count, the
+    // iterations between exchanges and the migration policy
+    island_t* island             = NULL;
+    char* island_name            = NULL;
+    int island_slots             = ISLAND_DEFAULT_SLOTS;
+    unsigned int island_interval = ISLAND_DEFAULT_INTERVAL;
+    int migration_policy         = ISLAND_POLICY_BEST;
+
+    // Journal of the accepted mutations, if enabled, and the iterations
+    // between two of its keyframes
+    journal_t* journal             = NULL;
+    int journaled                  = 0;
+    unsigned int journal_keyframes = JOURNAL_DEFAULT_KEYFRAMES;
+
+    // Number of polygons to start with in growth mode (0 to start with all
+    // of them) and the iterations without improvement before one is added
+    growth_t* growth          = NULL;
+    int growth_start          = 0;
+    unsigned int growth_stall = GROWTH_DEFAULT_STALL;
+
+    // Selected error kernel and render backend
+    const char* kernel;
+    const char* backend;
+
+    // Iteration counter
+    unsigned int iteration = 0;
 
     // Default simulated annealing values
     double temperature = 1000.0;
@@ -65,10 +176,21 @@ int main( int argc, char** argv )
     // Default polygon count
     int polygon_count = 50;
 
+    // Range of vertices every polygon may have
+    int min_vertices = POLYGON_DEFAULT_VERTICES;
+    int max_vertices = POLYGON_DEFAULT_VERTICES;
+
     // Default writeout values
     int svg_write_iterations = 10000;
     int png_write_iterations = 1000;
 
+    // Checkpoint interval and the checkpoint to continue from, if the run
+    // is resumed
+    int checkpoint_iterations = CHECKPOINT_DEFAULT_ITERATIONS;
+    int resume = 0;
+    char* checkpoint_file;
+    checkpoint_t* checkpoint = NULL;
+
     // Input file and output directory
     char* input_file;
     char* output_directory;
@@ -77,8 +199,31 @@ int main( int argc, char** argv )
     {
         extern char *optarg;
         extern int optind, optopt;
+        static struct option long_options[] = {
+            { "checkpoint",         required_argument, NULL, 'c' },
+            { "resume",             no_argument,       NULL, OPTION_RESUME },
+            { "seed",               required_argument, NULL, OPTION_SEED },
+            { "bench",              required_argument, NULL, OPTION_BENCH },
+            { "telemetry",          required_argument, NULL, OPTION_TELEMETRY },
+            { "telemetry-format",   required_argument, NULL, OPTION_TELEMETRY_FORMAT },
+            { "telemetry-interval", required_argument, NULL, OPTION_TELEMETRY_INTERVAL },
+            { "batch",              required_argument, NULL, OPTION_BATCH },
+            { "jobs",               required_argument, NULL, OPTION_JOBS },
+            { "sequence",           required_argument, NULL, OPTION_SEQUENCE },
+            { "warm-temperature",   required_argument, NULL, OPTION_WARM_TEMPERATURE },
+            { "warm-iterations",    required_argument, NULL, OPTION_WARM_ITERATIONS },
+            { "island",             required_argument, NULL, OPTION_ISLAND },
+            { "island-slots",       required_argument, NULL, OPTION_ISLAND_SLOTS },
+            { "island-interval",    required_argument, NULL, OPTION_ISLAND_INTERVAL },
+            { "island-policy",      required_argument, NULL, OPTION_ISLAND_POLICY },
+            { "journal",            no_argument,       NULL, OPTION_JOURNAL },
+            { "journal-keyframes",  required_argument, NULL, OPTION_JOURNAL_KEYFRAMES },
+            { "grow",               required_argument, NULL, OPTION_GROW },
+            { "grow-stall",         required_argument, NULL, OPTION_GROW_STALL },
+            { NULL,                 0,                 NULL, 0 }
+        };
         int c;
-        while( ( c = getopt( argc, argv, "t:a:e:s:p:n:" ) ) != -1 ) 
+        while( ( c = getopt_long( argc, argv, "t:a:e:s:p:n:v:i:k:ur:R:L:X:b:K:l:c:g:CS:", long_options, NULL ) ) != -1 ) 
         {
             switch( c ) 
             {
@@ -109,188 +254,592 @@ int main( int argc, char** argv )
                 case 'n':
                     polygon_count = atoi( optarg );
                 break;
+                case 'v':
+                    min_vertices = max_vertices = atoi( optarg );
+                    if ( strchr( optarg, ':' ) != NULL ) 
+                    {
+                        max_vertices = atoi( strchr( optarg, ':' ) + 1 );
+                    }
+                break;
+                case 'i':
+                    options.incremental_tile_size = atoi( optarg );
+                break;
+                case 'k':
+                    kernel_name = optarg;
+                break;
+                case 'u':
+                    options.in_place = 1;
+                break;
+                case 'r':
+                    backend_name = optarg;
+                break;
+                case 'R':
+                    replicas = atoi( optarg );
+                break;
+                case 'L':
+                    ladder = strtod( optarg, NULL );
+                break;
+                case 'X':
+                    exchange_steps = atoi( optarg );
+                break;
+                case 'b':
+                    options.bands = atoi( optarg );
+                break;
+                case 'K':
+                    speculative = atoi( optarg );
+                break;
+                case 'l':
+                    pyramid_levels = atoi( optarg );
+                break;
+                case 'c':
+                    checkpoint_iterations = atoi( optarg );
+                break;
+                case 'g':
+                    options.layer_groups = atoi( optarg );
+                break;
+                case 'C':
+                    options.cull = 1;
+                break;
+                case 'S':
+                    options.screen = atoi( optarg );
+                break;
+                case OPTION_RESUME:
+                    resume = 1;
+                break;
+                case OPTION_SEED:
+                    seed = strtoull( optarg, NULL, 10 );
+                    seeded = 1;
+                break;
+                case OPTION_BENCH:
+                    bench_iterations = strtoul( optarg, NULL, 10 );
+                break;
+                case OPTION_TELEMETRY:
+                    telemetry_file = optarg;
+                break;
+                case OPTION_TELEMETRY_FORMAT:
+                    telemetry_format = optarg;
+                break;
+                case OPTION_TELEMETRY_INTERVAL:
+                    telemetry_interval = strtod( optarg, NULL );
+                break;
+                case OPTION_BATCH:
+                    batch_source = optarg;
+                break;
+                case OPTION_JOBS:
+                    batch_workers = atoi( optarg );
+                break;
+                case OPTION_SEQUENCE:
+                    sequence_source = optarg;
+                break;
+                case OPTION_WARM_TEMPERATURE:
+                    warm_temperature = strtod( optarg, NULL );
+                break;
+                case OPTION_WARM_ITERATIONS:
+                    warm_iterations = strtoul( optarg, NULL, 10 );
+                break;
+                case OPTION_ISLAND:
+                    island_name = optarg;
+                break;
+                case OPTION_ISLAND_SLOTS:
+                    island_slots = atoi( optarg );
+                break;
+                case OPTION_ISLAND_INTERVAL:
+                    island_interval = strtoul( optarg, NULL, 10 );
+                break;
+                case OPTION_ISLAND_POLICY:
+                    migration_policy = island_policy( optarg );
+                break;
+                case OPTION_JOURNAL:
+                    journaled = 1;
+                break;
+                case OPTION_JOURNAL_KEYFRAMES:
+                    journal_keyframes = strtoul( optarg, NULL, 10 );
+                break;
+                case OPTION_GROW:
+                    growth_start = atoi( optarg );
+                break;
+                case OPTION_GROW_STALL:
+                    growth_stall = strtoul( optarg, NULL, 10 );
+                break;
             }
         }
 
-        if ( argc - optind < 2 ) 
+        // Batch and sequence mode take their inputs from the manifest
+        if ( argc - optind < ( batch_source != NULL || sequence_source != NULL ? 1 : 2 ) ) 
         {
             show_usage();
             exit( EXIT_FAILURE );
         }
     }
     
-    input_file       = argv[optind];      
-    output_directory = argv[optind + 1];
+    input_file       = batch_source != NULL ? batch_source : sequence_source != NULL ? sequence_source : argv[optind];      
+    output_directory = argv[argc - 1];
 
-    // Seed the random number generator
-    rand_seed();
+    checkpoint_file = malloc( sizeof( char ) * ( strlen( output_directory ) + strlen( CHECKPOINT_FILENAME ) + 2 ) );
+    sprintf( checkpoint_file, "%s/%s", output_directory, CHECKPOINT_FILENAME );
 
-    // Load the original image for comparison
+    // Seed the random number generator. Every chain and thread gets its
+    // own stream split off this one.
+    if ( bench_iterations > 0 && !seeded ) 
     {
-        cairo_t* cr;
-        cairo_surface_t* loaded_image = cairo_image_surface_create_from_png( input_file );
-        if ( cairo_surface_status( loaded_image ) != CAIRO_STATUS_SUCCESS ) 
-        {
-            printf( "Could not create input surface.\n" );
-            printf( "Make sure the input file is a valid PNG image.\n" );
-            exit( EXIT_FAILURE );
-        }    
-
-        // Make sure the input surface is 32bit ARGB. This is needed for the
-        // fitness comaprison to provide useful result values.
-        input_surface = cairo_image_surface_create( 
-            CAIRO_FORMAT_ARGB32,
-            cairo_image_surface_get_width( loaded_image ),
-            cairo_image_surface_get_height( loaded_image )
-        );
-        cr = cairo_create( input_surface );
-        cairo_set_source_surface( cr,
-            loaded_image,
-            .0,
-            .0       
-        );
-        cairo_paint( cr );
-        
-        cairo_destroy( cr );
-        cairo_surface_destroy( loaded_image );
+        seed = BENCH_DEFAULT_SEED;
     }
-        
-    // Create random polygon structure and initialize all needed values
-    polygons = initialize_polygons( input_surface, polygon_count );
-    best_polygons = copy_polygons( polygons );
-    initialize_new_render_surface( input_surface, &render_surface );
-    draw_polygons( render_surface, polygons );
-    current_fitness = quadratic_error( input_surface, render_surface );
-    best_fitness    = current_fitness;
-    
-    // Start simulated annealing cycle and try to find the optimal polygon
-    // approximation of the image
-    while( 1 ) 
+    rand_seed( &random, seed );
+    printf( "Seed: %llu\n", seed );
+
+    // Choose the fastest error kernel available on this cpu
+    kernel  = select_quadratic_error_kernel( kernel_name );
+    backend = select_render_backend( backend_name );
+    printf( "Error kernel: %s\n", kernel );
+    printf( "Render backend: %s\n", backend );
+
+    if ( batch_source != NULL && sequence_source != NULL ) 
     {
-        unsigned long long int new_fitness;
-        polygons_t* new_polygons;       
-        
-        // Write newline before any other status message
-        if ( ( png_write_iterations != 0 && iteration % png_write_iterations == 0 )
-          || ( svg_write_iterations != 0 && iteration % svg_write_iterations == 0 ) ) 
+        printf( "Batch and sequence mode can not be combined.\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    // Islands exchange genomes of the same size only
+    if ( growth_start > 0 && island_name != NULL ) 
+    {
+        printf( "Growth mode can not be combined with islands.\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    if ( batch_source != NULL || sequence_source != NULL ) 
+    {
+        // Every image or frame runs as a single chain with these settings
+        batch_settings_t settings;
+        settings.polygon_count        = polygon_count;
+        settings.min_vertices         = min_vertices;
+        settings.max_vertices         = max_vertices;
+        settings.temperature          = temperature;
+        settings.alpha                = alpha;
+        settings.epsilon              = epsilon;
+        settings.png_write_iterations = png_write_iterations;
+        settings.svg_write_iterations = svg_write_iterations;
+        settings.options              = options;
+
+        // Images and frames are not checkpointed
+        if ( resume || ( checkpoint_iterations != 0 && checkpoint_iterations != CHECKPOINT_DEFAULT_ITERATIONS ) ) 
         {
-            printf( "\n" );
+            printf( "Checkpoints are not supported in batch and sequence mode.\n" );
+            exit( EXIT_FAILURE );
         }
-    
-        // Write output png every x evolutions
-        if ( png_write_iterations != 0 && iteration % png_write_iterations == 0 ) 
+        free( checkpoint_file );
+        if ( sequence_source != NULL ) 
         {
-            char* filename = malloc( sizeof( char ) * ( strlen( output_directory ) + 32 ) );
+            // Anneal the frames in order, each one starting from the last
+            sequence_settings_t sequence = { &settings, warm_temperature, warm_iterations };
+            run_sequence( sequence_source, output_directory, &sequence, &random );
+            return EXIT_SUCCESS;
+        }
+        if ( run_batch( batch_source, output_directory, batch_workers, &settings, &random ) != 0 ) 
+        {
+            exit( EXIT_FAILURE );
+        }
+        return EXIT_SUCCESS;
+    }
 
-            initialize_new_render_surface( input_surface, &render_surface );
-            draw_polygons( render_surface, best_polygons );
-            
-            sprintf( filename, "%s/%010u.png", output_directory, iteration );
-            cairo_surface_write_to_png( render_surface, filename );
+    // Load the original image for comparison
+    if ( ( input_surface = load_image_surface( input_file ) ) == NULL ) 
+    {
+        printf( "Could not create input surface.\n" );
+        printf( "Make sure the input file is a valid PNG image.\n" );
+        exit( EXIT_FAILURE );
+    }
 
-            printf( "PNG: %s written.\n", filename );
-            free( filename );
-        }
+    writer    = initialize_snapshot_writer( input_surface, output_directory );
+    telemetry = initialize_telemetry( telemetry_file, telemetry_format, telemetry_interval );
 
-        // Write a svg every x iterations
-        if ( svg_write_iterations != 0 && iteration % svg_write_iterations == 0 ) 
+    if ( resume ) 
+    {
+        if ( replicas > 1 ) 
         {
-            char* filename = malloc( sizeof( char ) * ( strlen( output_directory ) + 32 ) );
-            sprintf( filename, "%s/%010u.svg", output_directory, iteration );
-
-            draw_polygons_to_svg( best_polygons, filename );
+            printf( "Checkpoints are not supported in parallel tempering mode.\n" );
+            exit( EXIT_FAILURE );
+        }
+        checkpoint = read_checkpoint( checkpoint_file );
+        iteration  = checkpoint->header.iteration;
+        printf( "Resuming from %s at iteration %u\n", checkpoint_file, iteration );
 
-            printf( "SVG: %s written.\n", filename );
-            free( filename );
+        // Measure the first window from the checkpoint on
+        {
+            telemetry_sample_t sample;
+            sample.iteration       = iteration;
+            sample.temperature     = checkpoint->header.temperature;
+            sample.current_fitness = checkpoint->header.current_fitness;
+            sample.best_fitness    = checkpoint->header.best_fitness;
+            sample.benefitial      = checkpoint->header.benefitial;
+            sample.annealing       = checkpoint->header.annealing;
+            reset_telemetry( telemetry, &sample );
         }
+    }
+        
+    if ( bench_iterations > 0 ) 
+    {
+        // Measure a fixed number of single chain steps without any output
+        bench_t bench = { input_file, kernel, backend, polygon_count, min_vertices, max_vertices, temperature, alpha, bench_iterations, seed };
+        char* filename = malloc( sizeof( char ) * ( strlen( output_directory ) + strlen( BENCH_FILENAME ) + 2 ) );
+        sprintf( filename, "%s/%s", output_directory, BENCH_FILENAME );
+        run_bench( input_surface, &bench, &options, filename );
+        free( filename );
+    }
+    else if ( replicas > 1 ) 
+    {
+        // Run the replicas concurrently and exchange temperatures between
+        // neighbours every few steps
+        unsigned int previous_iteration = 0;
+        tempering = initialize_tempering( input_surface, replicas, polygon_count, min_vertices, max_vertices, temperature, ladder, alpha, exchange_steps, &random, &options );
 
-        // Create new evolution
-        initialize_new_render_surface( input_surface, &render_surface );
-        new_polygons = copy_polygons( polygons );
-        evolve_polygons( new_polygons );
-        draw_polygons( render_surface, new_polygons );
-        new_fitness = quadratic_error( input_surface, render_surface );
-    
-        // Store polygons with the best fitness found so far
-        if ( new_fitness <= best_fitness ) 
+        while( 1 ) 
         {
-            free_polygons( best_polygons );
-            best_polygons = copy_polygons( new_polygons );
-            best_fitness = new_fitness;
+            int png = snapshot_due( previous_iteration, iteration, png_write_iterations );
+            int svg = snapshot_due( previous_iteration, iteration, svg_write_iterations );
+
+            if ( png || svg ) 
+            {
+                char name[16];
+                sprintf( name, "%010u", iteration );
+                printf( "\n" );
+                print_tempering_statistics( tempering );
+                queue_snapshot( writer, update_chain_best( best_chain( tempering ) ), name, png, svg );
+            }
+
+            run_tempering( tempering );
+            previous_iteration = iteration;
+            iteration += exchange_steps;
+
+            if ( telemetry_due( telemetry ) ) 
+            {
+                record_tempering_telemetry( telemetry, tempering, iteration, 0 );
+            }
+
+            // Check for abort condition
+            if( coldest_chain( tempering )->temperature < epsilon ) 
+            {
+                break;
+            }
         }
+        measure_tempering( tempering );
+        record_tempering_telemetry( telemetry, tempering, iteration, 1 );
+        printf( "\n" );
+        print_tempering_statistics( tempering );
 
-        // If the new evolution is better than the old one the old one will die
-        // and the new one will be taken further
-        if ( new_fitness < current_fitness ) 
+        queue_snapshot( writer, update_chain_best( best_chain( tempering ) ), "final", 1, 1 );
+        free_tempering( tempering );
+    }
+    else if ( speculative > 1 ) 
+    {
+        // Evaluate batches of candidates concurrently. Candidates are always
+        // rendered and scored completely here.
+        unsigned int previous_iteration = 0;
+        options.incremental_tile_size = 0;
+        options.bands = 0;
+        options.layer_groups = 0;
+        options.cull = 0;
+        options.screen = 0;
+        if ( checkpoint != NULL ) 
         {
-            ++benefitial;
-            free_polygons( polygons );
-            polygons = new_polygons;
-            current_fitness = new_fitness;
+            if ( checkpoint->header.levels != 1 ) 
+            {
+                printf( "The checkpoint was written in multi-resolution mode.\n" );
+                exit( EXIT_FAILURE );
+            }
+            chain = resume_chain( input_surface, checkpoint, &random, &options );
+            previous_iteration = iteration;
+            free_checkpoint( checkpoint );
         }
         else 
         {
-            // Only change to worse evolution with falling probability based on
-            // the iteration and the fitness difference
-            // Small changes in fitness are more likely to be accepted.
-            double randval = rand_double();
-            long long int fitness_difference           = new_fitness - current_fitness;
-            double fitness_temperature_division = ( fitness_difference / ( temperature * 10.0 ) );
-            double pb                           = exp( (double)(-1) * fitness_temperature_division );            
-            if( randval < pb ) 
+            chain = initialize_chain( input_surface, initialize_polygons( input_surface, polygon_count, min_vertices, max_vertices, &random ), temperature, &random, &options );
+        }
+        speculation = initialize_speculation( chain, speculative, alpha );
+
+        while( 1 ) 
+        {
+            int png = snapshot_due( previous_iteration, iteration, png_write_iterations );
+            int svg = snapshot_due( previous_iteration, iteration, svg_write_iterations );
+
+            if ( png || svg ) 
             {
-                ++annealing;
-                free_polygons( polygons );
-                polygons = new_polygons;
-                current_fitness = new_fitness;
+                char name[16];
+                sprintf( name, "%010u", iteration );
+                printf( "\n" );
+                queue_snapshot( writer, chain->best_polygons, name, png, svg );
             }
-            else 
+
+            if ( iteration != 0 && snapshot_due( previous_iteration, iteration, checkpoint_iterations ) ) 
+            {
+                measure_chain( chain );
+                write_checkpoint( checkpoint_file, chain, NULL, &random, iteration, 0, 1 );
+            }
+
+            previous_iteration = iteration;
+            iteration += step_speculation( speculation );
+
+            if ( telemetry_due( telemetry ) ) 
             {
-                // Don't accept the new change
-                free_polygons( new_polygons );
+                record_chain_telemetry( telemetry, chain, iteration, 0 );
             }
+
+            // Check for abort condition
+            if( chain->temperature < epsilon ) 
+            {
+                break;
+            }
+
+            // Lower the temperature
+            chain->temperature *= alpha;
         }
+        record_chain_telemetry( telemetry, chain, iteration, 0 );
+        printf( "\n" );
+        printf( "Speculation: %llu of %llu evaluated candidates used (%.2f%%)\n", 
+            speculation->consumed, 
+            speculation->evaluated,
+            100.0 * speculation->consumed / speculation->evaluated
+        );
+
+        queue_snapshot( writer, chain->best_polygons, "final", 1, 1 );
+        free_speculation( speculation );
+        free_chain( chain );
+    }
+    else 
+    {
+        pyramid_t* pyramid = initialize_pyramid( input_surface, pyramid_levels );
+        polygons_t* polygons = NULL;
+        unsigned int first_iteration = iteration;
+        int level = pyramid->levels - 1;
+
+        // Chain of the level finished last, its counters are carried over
+        // so they cover the whole run
+        chain_t* finished = NULL;
 
-        printf( "\r%u/%u/%u/%f (%llu)            ", benefitial, annealing, iteration, temperature, best_fitness );
+        // The temperature range is split geometrically between the levels.
+        // The coarse levels handle the hot start, the original resolution
+        // the cold end of the schedule.
+        double level_ratio = pow( epsilon / temperature, 1.0 / pyramid->levels );
 
-        // Check for abort condition
-        if( temperature < epsilon ) 
+        if ( checkpoint != NULL ) 
+        {
+            if ( checkpoint->header.levels != pyramid->levels ) 
+            {
+                printf( "The checkpoint was written with %d resolution levels.\n", checkpoint->header.levels );
+                exit( EXIT_FAILURE );
+            }
+            level = checkpoint->header.level;
+        }
+        else 
         {
-            break;
+            // Create random polygon structure and initialize all needed values
+            polygons = initialize_polygons( pyramid->surfaces[level], growth_start > 0 && growth_start < polygon_count ? growth_start : polygon_count, min_vertices, max_vertices, &random );
         }
 
-        // Lower the temperature
-        temperature *= alpha;
+        // Start with a few polygons and add the others one by one
+        if ( growth_start > 0 && growth_start < polygon_count ) 
+        {
+            growth = initialize_growth( polygon_count, growth_stall );
+        }
 
-        ++iteration;
-    }
-    printf( "\n" );
+        for( ; level>=0; --level ) 
+        {
+            // The error sums scale with the pixel count. Scale the
+            // temperatures as well to keep the acceptance probabilities of a
+            // level comparable to the original resolution.
+            double pixel_ratio = pyramid_pixel_ratio( pyramid, level );
+            double level_start = temperature * pow( level_ratio, pyramid->levels - 1 - level ) * pixel_ratio;
+            double level_end   = ( level == 0 ? epsilon : temperature * pow( level_ratio, pyramid->levels - level ) ) * pixel_ratio;
+
+            if ( pyramid->levels > 1 ) 
+            {
+                printf( "Level %d (%dx%d): %f to %f\n", 
+                    level, 
+                    cairo_image_surface_get_width( pyramid->surfaces[level] ),
+                    cairo_image_surface_get_height( pyramid->surfaces[level] ),
+                    level_start,
+                    level_end
+                );
+            }
 
-    // Render the best state found so far to png and svg
-    {
-        char* filename = malloc( sizeof( char ) * strlen( output_directory ) + 16 );
+            if ( growth != NULL ) 
+            {
+                reset_growth( growth, iteration );
+            }
+
+            if ( checkpoint != NULL ) 
+            {
+                chain = resume_chain( pyramid->surfaces[level], checkpoint, &random, &options );
+                if ( growth != NULL ) 
+                {
+                    resume_growth( growth, checkpoint );
+                }
+                free_checkpoint( checkpoint );
+                checkpoint = NULL;
+            }
+            else 
+            {
+                chain = initialize_chain( pyramid->surfaces[level], polygons, level_start, &random, &options );
+            }
+            if ( finished != NULL ) 
+            {
+                chain->benefitial = finished->benefitial;
+                chain->annealing  = finished->annealing;
+                chain->profile    = finished->profile;
+                free_chain( finished );
+                finished = NULL;
+            }
 
-        initialize_new_render_surface( input_surface, &render_surface );
-        draw_polygons( render_surface, best_polygons );
-        sprintf( filename, "%s/final.png", output_directory );
-        cairo_surface_write_to_png( render_surface, filename );
-        printf( "PNG: %s written.\n", filename );
+            // Islands only exchange genomes at the original resolution
+            if ( island_name != NULL && level == 0 ) 
+            {
+                island = initialize_island( island_name, island_slots, migration_policy, input_surface, chain->polygons, &random );
+            }
 
-        sprintf( filename, "%s/final.svg", output_directory );
-        draw_polygons_to_svg( best_polygons, filename );
-        printf( "SVG: %s written.\n", filename );
+            // Every level starts with a keyframe, its polygons are on a
+            // canvas of their own
+            if ( journaled ) 
+            {
+                if ( journal == NULL ) 
+                {
+                    char* filename = malloc( sizeof( char ) * ( strlen( output_directory ) + strlen( JOURNAL_FILENAME ) + 2 ) );
+                    sprintf( filename, "%s/%s", output_directory, JOURNAL_FILENAME );
+                    journal = initialize_journal( filename, chain->polygons, polygon_count, cairo_image_surface_get_width( input_surface ), cairo_image_surface_get_height( input_surface ), resume );
+                    free( filename );
+                }
+                journal_keyframe( journal, chain->polygons, iteration );
+            }
+        
+            // Start simulated annealing cycle and try to find the optimal polygon
+            // approximation of the image
+            while( 1 ) 
+            {
+                int png = png_write_iterations != 0 && iteration % png_write_iterations == 0;
+                int svg = svg_write_iterations != 0 && iteration % svg_write_iterations == 0;
+
+                // Write output png and svg every x evolutions
+                if ( png || svg ) 
+                {
+                    char name[16];
+                    sprintf( name, "%010u", iteration );
+                    printf( "\n" );
+                    queue_snapshot( writer, update_chain_best( chain ), name, png, svg );
+                }
+
+                // Save the complete state every x evolutions
+                if ( checkpoint_iterations != 0 && iteration % checkpoint_iterations == 0 && iteration != first_iteration ) 
+                {
+                    measure_chain( chain );
+                    write_checkpoint( checkpoint_file, chain, growth, &random, iteration, level, pyramid->levels );
+                }
+
+                // Publish the best state and adopt a better migrant
+                if ( island != NULL && island_interval != 0 && iteration % island_interval == 0 ) 
+                {
+                    unsigned long long int adopted = island->adopted;
+                    chain = migrate_island( island, chain, &random, &options );
+                    if ( journal != NULL && island->adopted != adopted ) 
+                    {
+                        journal_keyframe( journal, chain->polygons, iteration );
+                    }
+                }
+
+                // Add a polygon once the best fitness stops improving
+                if ( growth != NULL ) 
+                {
+                    int count = chain->polygons->count;
+                    chain = grow_chain( growth, chain, iteration, &random, &options );
+                    if ( journal != NULL && chain->polygons->count != count ) 
+                    {
+                        journal_keyframe( journal, chain->polygons, iteration );
+                    }
+                }
+
+                // Write a keyframe every x evolutions, unless one has just
+                // been written
+                if ( journal != NULL && journal_keyframes != 0 && iteration % journal_keyframes == 0 && journal->iteration != iteration ) 
+                {
+                    journal_keyframe( journal, chain->polygons, iteration );
+                }
+
+                if ( step_chain( chain ) && journal != NULL ) 
+                {
+                    journal_mutation( journal, chain->polygons, chain->mutated, &chain->undo.polygon, iteration );
+                }
+
+                if ( telemetry_due( telemetry ) ) 
+                {
+                    record_chain_telemetry( telemetry, chain, iteration, 0 );
+                }
+
+                // Check for abort condition
+                if( chain->temperature < level_end ) 
+                {
+                    break;
+                }
+
+                // Lower the temperature
+                chain->temperature *= alpha;
+
+                ++iteration;
+            }
+            measure_chain( chain );
+            record_chain_telemetry( telemetry, chain, iteration, 1 );
+            printf( "\n" );
+            if ( chain->spatial != NULL ) 
+            {
+                print_spatial_statistics( chain->spatial );
+            }
+            if ( chain->screen != NULL ) 
+            {
+                print_screen_statistics( chain->screen );
+            }
 
-        free( filename );        
+            if ( level == 0 ) 
+            {
+                if ( island != NULL ) 
+                {
+                    // Leave the final state to the other islands
+                    chain = migrate_island( island, chain, &random, &options );
+                    print_island_statistics( island );
+                    free_island( island );
+                }
+                if ( growth != NULL ) 
+                {
+                    printf( "Growth: %d of %d polygons, %u added\n", chain->polygons->count, growth->target, growth->added );
+                    free_growth( growth );
+                }
+                if ( journal != NULL ) 
+                {
+                    // The journal ends with the best polygons, like the
+                    // final snapshot
+                    journal_keyframe( journal, update_chain_best( chain ), iteration + 1 );
+                    print_journal_statistics( journal );
+                    free_journal( journal );
+                }
+                break;
+            }
+
+            // Continue on the next finer level with the best state found
+            polygons = copy_polygons( update_chain_best( chain ) );
+            scale_polygons( polygons,
+                cairo_image_surface_get_width( pyramid->surfaces[level - 1] ),
+                cairo_image_surface_get_height( pyramid->surfaces[level - 1] )
+            );
+            finished = chain;
+            ++iteration;
+        }
+
+        // Render the best state found so far to png and svg
+        queue_snapshot( writer, update_chain_best( chain ), "final", 1, 1 );
+        free_chain( chain );
+        free_pyramid( pyramid );
     }
     
-    // Free the allocated memory
-    if ( polygons != NULL  )
-        free_polygons( polygons );
-    if ( best_polygons != NULL  )
-        free_polygons( best_polygons );
-
-    cairo_surface_destroy( render_surface );
+    // Wait for the pending snapshots and free the allocated memory
+    free_snapshot_writer( writer );
+    free_telemetry( telemetry );
     cairo_surface_destroy( input_surface );
+    free( checkpoint_file );
 }
 
 static void show_usage() 
@@ -299,6 +848,8 @@ static void show_usage()
     printf( "(c) Jakob Westhoff <jakob@php.net>\n" );
     printf( "Usage:\n" );
     printf( "   evolver [options] <inputfile> <outputdirectory>\n" );
+    printf( "   evolver [options] --batch <manifest|directory> <outputdirectory>\n" );
+    printf( "   evolver [options] --sequence <manifest|directory> <outputdirectory>\n" );
     printf( "Options:\n" );
     printf( "   -p <int>:   Save current state as png every <number>\n\
                iterations (Default: 1000) (0 to disable)\n" );
@@ -312,63 +863,159 @@ static void show_usage()
                iteration (Default: 0.99999)\n" );
     printf( "   -n <int>:   Number of polygons to evolve \n\
                (Default: 50)\n" );
+    printf( "   -v <int>[:<int>]: Number of vertices of every polygon, or\n\
+               the range it may vary in by adding and\n\
+               removing vertices (Default: %d) (%d to %d)\n", POLYGON_DEFAULT_VERTICES, POLYGON_MIN_VERTICES, POLYGON_MAX_VERTICES );
+    printf( "   -i <int>:   Evaluate mutations incrementally, caching the\n\
+               error of <int> pixel tiles (Default: 0)\n\
+               (0 to disable, %d is a good start)\n", INCREMENTAL_DEFAULT_TILE_SIZE );
+    printf( "   -k <name>:  Error kernel to use (avx512, avx2, sse2 or\n\
+               scalar) (Default: best supported by the cpu)\n" );
+    printf( "   -u:         Mutate the polygons in place and undo rejected\n\
+               mutations instead of copying them every iteration\n" );
+    printf( "   -r <name>:  Render backend to use (cairo or scanline)\n\
+               (Default: cairo) SVG files are always drawn by cairo\n" );
+    printf( "   -R <int>:   Run <int> parallel tempering replicas on their\n\
+               own threads (Default: 0) (0 for a single chain)\n" );
+    printf( "   -L <float>: Temperature ratio between neighbouring\n\
+               replicas (Default: %.1f)\n", TEMPERING_DEFAULT_LADDER );
+    printf( "   -X <int>:   Steps between replica exchanges\n\
+               (Default: %d)\n", TEMPERING_DEFAULT_STEPS );
+    printf( "   -b <int>:   Split the rendering and scoring of full\n\
+               evaluations into <int> bands processed on\n\
+               their own threads (Default: 0) (0 to disable)\n" );
+    printf( "   -K <int>:   Evaluate <int> speculative candidates per\n\
+               step concurrently and take the first accepted\n\
+               one (Default: 0) (0 to disable, -i, -b, -g, -C\n\
+               and -S are ignored)\n" );
+    printf( "   -g <int>:   Cache the composites below and above <int>\n\
+               polygon groups and only redraw the mutated\n\
+               group (Default: 0) (0 to disable, ignored with\n\
+               -i) The fitness may differ from a full redraw\n\
+               by the rounding of the layer blending\n" );
+    printf( "   -C:         Index the polygon bounding boxes and skip the\n\
+               polygons outside of the redrawn region or\n\
+               provably invisible (ignored with -b and -g)\n" );
+    printf( "   -S <int>:   Score candidates on every <int>th row first\n\
+               and only on all rows if they may still be\n\
+               accepted (Default: 0) (0 to disable, %d is a\n\
+               good start, ignored with -i, -b and -g)\n", SCREEN_DEFAULT_STRIDE );
+    printf( "   -l <int>:   Anneal on <int> resolution levels, each half\n\
+               the size of the next, coarsest first\n\
+               (Default: 1) (single chain mode only)\n" );
+    printf( "   -c, --checkpoint <int>: Save the complete annealing state\n\
+               every <int> iterations to %s in the\n\
+               output directory (Default: %d) (0 to disable)\n\
+               (not in parallel tempering, batch and sequence\n\
+               mode)\n", CHECKPOINT_FILENAME, CHECKPOINT_DEFAULT_ITERATIONS );
+    printf( "   --seed <int>: Seed of the random number generator\n\
+               (Default: current time)\n" );
+    printf( "   --bench <int>: Run <int> single chain iterations without\n\
+               any output and write the timing of every\n\
+               phase to %s in the output directory\n\
+               (Seed: %d unless given)\n", BENCH_FILENAME, BENCH_DEFAULT_SEED );
+    printf( "   --telemetry <file>: Write progress records to <file>\n\
+               (a path or a named pipe)\n" );
+    printf( "   --telemetry-format <name>: Format of the records (ndjson\n\
+               or csv) (Default: ndjson)\n" );
+    printf( "   --telemetry-interval <float>: Seconds between two records\n\
+               and terminal updates (Default: %.1f)\n", TELEMETRY_DEFAULT_INTERVAL );
+    printf( "   --batch <manifest|directory>: Process every png of the\n\
+               directory, or every path listed in the manifest\n\
+               (one per line), writing to a subdirectory of the\n\
+               output directory each. Single chain mode only.\n" );
+    printf( "   --jobs <int>: Number of batch images processed\n\
+               concurrently (Default: number of cpus)\n" );
+    printf( "   --sequence <manifest|directory>: Process the frames in\n\
+               order, each one starting from the best polygons\n\
+               of the frame before, and write them as\n\
+               frame<number>.png/svg to the output directory.\n\
+               Single chain mode only.\n" );
+    printf( "   --warm-temperature <float>: Initial temperature of every\n\
+               frame but the first (Default: %.2f times -t)\n", SEQUENCE_DEFAULT_WARM_RATIO );
+    printf( "   --warm-iterations <int>: Iterations of every frame but the\n\
+               first (Default: %d times fewer than the first)\n", SEQUENCE_DEFAULT_WARM_SPEEDUP );
+    printf( "   --island <name>: Exchange the best polygons with other\n\
+               processes through the shared memory segment\n\
+               <name>, created by the first one. All of them\n\
+               need the same image, -n and -v. Single chain\n\
+               mode only. The segment persists until it is\n\
+               removed from /dev/shm.\n" );
+    printf( "   --island-slots <int>: Number of processes the segment is\n\
+               created for (Default: %d)\n", ISLAND_DEFAULT_SLOTS );
+    printf( "   --island-interval <int>: Iterations between two exchanges\n\
+               (Default: %d)\n", ISLAND_DEFAULT_INTERVAL );
+    printf( "   --island-policy <name>: Migrant to adopt if it is better\n\
+               than the current state, the best one of all\n\
+               islands, a random one, or none to only\n\
+               publish (best, random or none) (Default: best)\n" );
+    printf( "   --journal:  Append every accepted mutation to %s\n\
+               in the output directory, a few bytes each, and\n\
+               the whole state at every keyframe. The states\n\
+               can be rendered with the replay tool. Single\n\
+               chain mode only.\n", JOURNAL_FILENAME );
+    printf( "   --journal-keyframes <int>: Iterations between two keyframes\n\
+               (Default: %d) (0 for keyframes at the start of\n\
+               every level only)\n", JOURNAL_DEFAULT_KEYFRAMES );
+    printf( "   --grow <int>: Start with <int> polygons and add one on top\n\
+               of the area with the highest error whenever\n\
+               the best fitness stops improving, until -n\n\
+               polygons are reached. Single chain mode only,\n\
+               not with --island.\n" );
+    printf( "   --grow-stall <int>: Iterations the best fitness needs to\n\
+               improve by %.1f%% in to not add a polygon\n\
+               (Default: %d)\n", GROWTH_MIN_IMPROVEMENT * 100, GROWTH_DEFAULT_STALL );
+    printf( "   --resume:   Continue the run from the checkpoint in the\n\
+               output directory. Use the same options as\n\
+               the interrupted run. Not in parallel\n\
+               tempering, batch and sequence mode.\n" );
 }
 
-static unsigned long long int quadratic_error( cairo_surface_t* original, cairo_surface_t* destination ) 
+static int snapshot_due( unsigned int previous_iteration, unsigned int iteration, int every ) 
 {
-    unsigned char *original_data, *destination_data;
-    int i;
-    unsigned long long int quadratic_error = 0;        
-    int size = cairo_image_surface_get_height( original )*cairo_image_surface_get_stride( original );
-
-    original_data = cairo_image_surface_get_data( original );
-    if ( original_data == NULL ) 
-    {
-        printf( "Could not access original image data during compare\n" );
-        exit( EXIT_FAILURE );
-    }
-    destination_data = cairo_image_surface_get_data( destination );
-    if ( destination_data == NULL ) 
+    // Iterations may advance in steps larger than one. A snapshot is due
+    // whenever a multiple of the interval has been passed since the last
+    // check.
+    if ( every == 0 ) 
     {
-        printf( "Could not access destination image data during compare\n" );
-        exit( EXIT_FAILURE );
+        return 0;
     }
+    return iteration == 0 || iteration / every != previous_iteration / every;
+}
 
-    for( i=0; i<size; ++i ) 
-    {
-        int difference = destination_data[i] - original_data[i];
-        int quadratic_difference = difference * difference;
+static void record_chain_telemetry( telemetry_t* telemetry, chain_t* chain, unsigned int iteration, int exact ) 
+{
+    // The exact values are only up to date right after measure_chain
+    telemetry_sample_t sample;
 
-        // Make sure there will be no overflow
-        if ( quadratic_error + quadratic_difference < quadratic_error ) 
-        {
-            return ULLONG_MAX;
-        }
-        else 
-        {
-            quadratic_error += quadratic_difference;
-        }
-    }
-    return quadratic_error;
+    sample.iteration       = iteration;
+    sample.temperature     = chain->temperature;
+    sample.current_fitness = exact ? chain->exact_current_fitness : chain->current_fitness;
+    sample.best_fitness    = exact ? chain->exact_best_fitness : chain->best_fitness;
+    sample.benefitial      = chain->benefitial;
+    sample.annealing       = chain->annealing;
+
+    record_telemetry( telemetry, &sample );
 }
 
-static void initialize_new_render_surface( cairo_surface_t* input, cairo_surface_t** render_surface ) 
+static void record_tempering_telemetry( telemetry_t* telemetry, tempering_t* tempering, unsigned int iteration, int exact ) 
 {
-    if ( *render_surface != NULL ) 
-    {
-        cairo_surface_destroy( *render_surface );
-    }
-    
-    // Retrieve input metadata and create render_surface
-    *render_surface = cairo_surface_create_similar( 
-        input,
-        CAIRO_CONTENT_COLOR_ALPHA,
-        cairo_image_surface_get_width( input ),
-        cairo_image_surface_get_height( input )
-    );
-    if ( cairo_surface_status( *render_surface ) != CAIRO_STATUS_SUCCESS ) 
+    // Counters are summed over all replicas, the temperature and current
+    // fitness are the ones of the coldest rung
+    telemetry_sample_t sample;
+    int i;
+
+    sample.iteration       = iteration;
+    sample.temperature     = coldest_chain( tempering )->temperature;
+    sample.current_fitness = exact ? coldest_chain( tempering )->exact_current_fitness : coldest_chain( tempering )->current_fitness;
+    sample.best_fitness    = exact ? best_chain( tempering )->exact_best_fitness : best_chain( tempering )->best_fitness;
+    sample.benefitial      = 0;
+    sample.annealing       = 0;
+    for( i=0; i<tempering->count; ++i ) 
     {
-        printf( "Could not create render surface.\n" );
-        exit( EXIT_FAILURE );
+        sample.benefitial += tempering->chains[i]->benefitial;
+        sample.annealing  += tempering->chains[i]->annealing;
     }
+
+    record_telemetry( telemetry, &sample );
 }
@@ -0,0 +1,354 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cairo.h>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+    #define FITNESS_X86_KERNELS
+    #include <immintrin.h>
+#endif
+
+#include "polygon.h"
+#include "fitness.h"
+
+// Number of vector iterations whose squared differences are summed up in
+// 32bit lanes before they are widened into the 64bit totals. Every lane
+// gains at most 2 * 2 * 255^2 = 260100 per iteration.
+#define QUADRATIC_ERROR_BLOCK 8192
+
+typedef struct quadratic_error_kernel_entry 
+{
+    const char* name;
+    quadratic_error_kernel_t kernel;
+    int (*supported)();
+} quadratic_error_kernel_entry_t;
+
+static unsigned char* surface_data( cairo_surface_t* surface, const char* name );
+static int kernel_always_supported();
+static int validate_quadratic_error_kernel( quadratic_error_kernel_t kernel );
+
+#ifdef FITNESS_X86_KERNELS
+static unsigned long long int quadratic_error_sse2( unsigned char* original, unsigned char* destination, int length );
+static unsigned long long int quadratic_error_avx2( unsigned char* original, unsigned char* destination, int length );
+static unsigned long long int quadratic_error_avx512( unsigned char* original, unsigned char* destination, int length );
+static int kernel_sse2_supported();
+static int kernel_avx2_supported();
+static int kernel_avx512_supported();
+#endif
+
+// Available kernels ordered from the most to the least preferable one
+static quadratic_error_kernel_entry_t kernels[] = {
+#ifdef FITNESS_X86_KERNELS
+    { "avx512", quadratic_error_avx512, kernel_avx512_supported },
+    { "avx2",   quadratic_error_avx2,   kernel_avx2_supported },
+    { "sse2",   quadratic_error_sse2,   kernel_sse2_supported },
+#endif
+    { "scalar", quadratic_error_scalar, kernel_always_supported }
+};
+
+static quadratic_error_kernel_t quadratic_error_kernel = quadratic_error_scalar;
+
+const char* select_quadratic_error_kernel( const char* name ) 
+{
+    int i;
+    int count = sizeof( kernels ) / sizeof( kernels[0] );
+
+#ifdef FITNESS_X86_KERNELS
+    __builtin_cpu_init();
+#endif
+
+    for( i=0; i<count; ++i ) 
+    {
+        if ( name != NULL && strcmp( name, kernels[i].name ) != 0 ) 
+        {
+            continue;
+        }
+        if ( !kernels[i].supported() ) 
+        {
+            if ( name != NULL ) 
+            {
+                printf( "The %s error kernel is not supported by this cpu.\n", name );
+                exit( EXIT_FAILURE );
+            }
+            continue;
+        }
+        if ( !validate_quadratic_error_kernel( kernels[i].kernel ) ) 
+        {
+            printf( "The %s error kernel does not match the scalar reference.\n", kernels[i].name );
+            exit( EXIT_FAILURE );
+        }
+        quadratic_error_kernel = kernels[i].kernel;
+        return kernels[i].name;
+    }
+
+    printf( "Unknown error kernel %s.\n", name );
+    exit( EXIT_FAILURE );
+}
+
+unsigned long long int quadratic_error_scalar( unsigned char* original, unsigned char* destination, int length ) 
+{
+    int i;
+    unsigned long long int quadratic_error = 0;
+    for( i=0; i<length; ++i ) 
+    {
+        int difference = destination[i] - original[i];
+        quadratic_error += difference * difference;
+    }
+    return quadratic_error;
+}
+
+unsigned long long int quadratic_error( cairo_surface_t* original, cairo_surface_t* destination ) 
+{
+    unsigned char *original_data, *destination_data;
+    int size = cairo_image_surface_get_height( original )*cairo_image_surface_get_stride( original );
+
+    original_data    = surface_data( original, "original" );
+    destination_data = surface_data( destination, "destination" );
+
+    // The sum can not overflow: Even 2^31 bytes with the maximal difference
+    // of 255 each stay far below 2^64.
+    return quadratic_error_kernel( original_data, destination_data, size );
+}
+
+unsigned long long int quadratic_error_bounded( cairo_surface_t* original, cairo_surface_t* destination, unsigned long long int limit ) 
+{
+    unsigned char *original_data, *destination_data;
+    int y;
+    unsigned long long int quadratic_error = 0;
+    int height = cairo_image_surface_get_height( original );
+    int stride = cairo_image_surface_get_stride( original );
+
+    original_data    = surface_data( original, "original" );
+    destination_data = surface_data( destination, "destination" );
+
+    // Stop as soon as the partial sum exceeds the limit. The returned value
+    // is only exact if it is not above the limit.
+    for( y=0; y<height && quadratic_error <= limit; y += QUADRATIC_ERROR_BOUND_ROWS ) 
+    {
+        int rows = y + QUADRATIC_ERROR_BOUND_ROWS > height ? height - y : QUADRATIC_ERROR_BOUND_ROWS;
+        quadratic_error += quadratic_error_kernel( 
+            original_data + y * stride, 
+            destination_data + y * stride,
+            rows * stride
+        );
+    }
+    return quadratic_error;
+}
+
+unsigned long long int quadratic_error_region( cairo_surface_t* original, cairo_surface_t* destination, region_t* region ) 
+{
+    unsigned char *original_data, *destination_data;
+    int y;
+    unsigned long long int quadratic_error = 0;
+    int stride = cairo_image_surface_get_stride( original );
+
+    original_data    = surface_data( original, "original" );
+    destination_data = surface_data( destination, "destination" );
+
+    // Only the bytes of the 32bit pixels inside the region are compared.
+    for( y=region->y0; y<region->y1; ++y ) 
+    {
+        quadratic_error += quadratic_error_kernel( 
+            original_data + y * stride + region->x0 * 4, 
+            destination_data + y * stride + region->x0 * 4,
+            ( region->x1 - region->x0 ) * 4
+        );
+    }
+    return quadratic_error;
+}
+
+unsigned long long int quadratic_error_rows( cairo_surface_t* original, cairo_surface_t* destination, unsigned long long int* errors, int first, int step ) 
+{
+    unsigned char *original_data, *destination_data;
+    int y;
+    unsigned long long int quadratic_error = 0;
+    int stride = cairo_image_surface_get_stride( original );
+    int width  = cairo_image_surface_get_width( original );
+    int height = cairo_image_surface_get_height( original );
+
+    original_data    = surface_data( original, "original" );
+    destination_data = surface_data( destination, "destination" );
+
+    // Every step-th row from the first one on. The error of each row is
+    // stored at its index as well.
+    for( y=first; y<height; y+=step ) 
+    {
+        errors[y] = quadratic_error_kernel( original_data + y * stride, destination_data + y * stride, width * 4 );
+        quadratic_error += errors[y];
+    }
+    return quadratic_error;
+}
+
+static unsigned char* surface_data( cairo_surface_t* surface, const char* name ) 
+{
+    unsigned char* data;
+    cairo_surface_flush( surface );
+    data = cairo_image_surface_get_data( surface );
+    if ( data == NULL ) 
+    {
+        printf( "Could not access %s image data during compare\n", name );
+        exit( EXIT_FAILURE );
+    }
+    return data;
+}
+
+static int kernel_always_supported() 
+{
+    return 1;
+}
+
+static int validate_quadratic_error_kernel( quadratic_error_kernel_t kernel ) 
+{
+    // Compare against the scalar reference on a pattern covering the full
+    // byte range, unaligned starts and every possible tail length
+    int i, offset, length;
+    int size = 4096;
+    unsigned char* original    = malloc( sizeof( unsigned char ) * size );
+    unsigned char* destination = malloc( sizeof( unsigned char ) * size );
+    int valid = 1;
+
+    for( i=0; i<size; ++i ) 
+    {
+        original[i]    = (unsigned char)( i * 7 + ( i >> 8 ) );
+        destination[i] = (unsigned char)( ( i % 3 == 0 ) ? 255 - original[i] : i * 13 );
+    }
+
+    for( offset=0; offset<4 && valid; ++offset ) 
+    {
+        for( length=0; length<=size - offset && valid; length += ( length < 256 ? 1 : 509 ) ) 
+        {
+            valid = kernel( original + offset, destination + offset, length ) 
+                 == quadratic_error_scalar( original + offset, destination + offset, length );
+        }
+    }
+
+    free( original );
+    free( destination );
+    return valid;
+}
+
+#ifdef FITNESS_X86_KERNELS
+
+static int kernel_sse2_supported() 
+{
+    return __builtin_cpu_supports( "sse2" );
+}
+
+static int kernel_avx2_supported() 
+{
+    return __builtin_cpu_supports( "avx2" );
+}
+
+static int kernel_avx512_supported() 
+{
+    return __builtin_cpu_supports( "avx512f" ) && __builtin_cpu_supports( "avx512bw" );
+}
+
+__attribute__(( target( "sse2" ) ))
+static unsigned long long int quadratic_error_sse2( unsigned char* original, unsigned char* destination, int length ) 
+{
+    int i = 0;
+    unsigned long long int lanes[2];
+    __m128i zero  = _mm_setzero_si128();
+    __m128i total = _mm_setzero_si128();
+
+    while( i + 16 <= length ) 
+    {
+        int block;
+        __m128i sum = _mm_setzero_si128();
+        for( block=0; block<QUADRATIC_ERROR_BLOCK && i + 16 <= length; ++block, i += 16 ) 
+        {
+            __m128i o = _mm_loadu_si128( (__m128i*)( original + i ) );
+            __m128i d = _mm_loadu_si128( (__m128i*)( destination + i ) );
+            // Widen to 16bit, subtract and let madd square and pairwise add
+            __m128i low  = _mm_sub_epi16( _mm_unpacklo_epi8( d, zero ), _mm_unpacklo_epi8( o, zero ) );
+            __m128i high = _mm_sub_epi16( _mm_unpackhi_epi8( d, zero ), _mm_unpackhi_epi8( o, zero ) );
+            sum = _mm_add_epi32( sum, _mm_madd_epi16( low, low ) );
+            sum = _mm_add_epi32( sum, _mm_madd_epi16( high, high ) );
+        }
+        total = _mm_add_epi64( total, _mm_unpacklo_epi32( sum, zero ) );
+        total = _mm_add_epi64( total, _mm_unpackhi_epi32( sum, zero ) );
+    }
+
+    _mm_storeu_si128( (__m128i*)lanes, total );
+    return lanes[0] + lanes[1] + quadratic_error_scalar( original + i, destination + i, length - i );
+}
+
+__attribute__(( target( "avx2" ) ))
+static unsigned long long int quadratic_error_avx2( unsigned char* original, unsigned char* destination, int length ) 
+{
+    int i = 0;
+    unsigned long long int lanes[4];
+    __m256i zero  = _mm256_setzero_si256();
+    __m256i total = _mm256_setzero_si256();
+
+    while( i + 32 <= length ) 
+    {
+        int block;
+        __m256i sum = _mm256_setzero_si256();
+        for( block=0; block<QUADRATIC_ERROR_BLOCK && i + 32 <= length; ++block, i += 32 ) 
+        {
+            __m256i o = _mm256_loadu_si256( (__m256i*)( original + i ) );
+            __m256i d = _mm256_loadu_si256( (__m256i*)( destination + i ) );
+            __m256i low  = _mm256_sub_epi16( _mm256_unpacklo_epi8( d, zero ), _mm256_unpacklo_epi8( o, zero ) );
+            __m256i high = _mm256_sub_epi16( _mm256_unpackhi_epi8( d, zero ), _mm256_unpackhi_epi8( o, zero ) );
+            sum = _mm256_add_epi32( sum, _mm256_madd_epi16( low, low ) );
+            sum = _mm256_add_epi32( sum, _mm256_madd_epi16( high, high ) );
+        }
+        total = _mm256_add_epi64( total, _mm256_unpacklo_epi32( sum, zero ) );
+        total = _mm256_add_epi64( total, _mm256_unpackhi_epi32( sum, zero ) );
+    }
+
+    _mm256_storeu_si256( (__m256i*)lanes, total );
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] 
+         + quadratic_error_sse2( original + i, destination + i, length - i );
+}
+
+__attribute__(( target( "avx512f,avx512bw" ) ))
+static unsigned long long int quadratic_error_avx512( unsigned char* original, unsigned char* destination, int length ) 
+{
+    int i = 0;
+    __m512i zero  = _mm512_setzero_si512();
+    __m512i total = _mm512_setzero_si512();
+
+    while( i + 64 <= length ) 
+    {
+        int block;
+        __m512i sum = _mm512_setzero_si512();
+        for( block=0; block<QUADRATIC_ERROR_BLOCK && i + 64 <= length; ++block, i += 64 ) 
+        {
+            __m512i o = _mm512_loadu_si512( (void*)( original + i ) );
+            __m512i d = _mm512_loadu_si512( (void*)( destination + i ) );
+            __m512i low  = _mm512_sub_epi16( _mm512_unpacklo_epi8( d, zero ), _mm512_unpacklo_epi8( o, zero ) );
+            __m512i high = _mm512_sub_epi16( _mm512_unpackhi_epi8( d, zero ), _mm512_unpackhi_epi8( o, zero ) );
+            sum = _mm512_add_epi32( sum, _mm512_madd_epi16( low, low ) );
+            sum = _mm512_add_epi32( sum, _mm512_madd_epi16( high, high ) );
+        }
+        total = _mm512_add_epi64( total, _mm512_unpacklo_epi32( sum, zero ) );
+        total = _mm512_add_epi64( total, _mm512_unpackhi_epi32( sum, zero ) );
+    }
+
+    return (unsigned long long int)_mm512_reduce_add_epi64( total ) 
+         + quadratic_error_avx2( original + i, destination + i, length - i );
+}
+
+#endif
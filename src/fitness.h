@@ -0,0 +1,43 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef FITNESS_H
+#define FITNESS_H
+
+#ifndef ULLONG_MAX
+    #define ULLONG_MAX 18446744073709551615ULL
+#endif
+
+// Number of rows compared between two checks against the limit of a
+// bounded error calculation
+#define QUADRATIC_ERROR_BOUND_ROWS 8
+
+// Sum of squared byte differences of two equally long buffers
+typedef unsigned long long int (*quadratic_error_kernel_t)( unsigned char* original, unsigned char* destination, int length );
+
+const char* select_quadratic_error_kernel( const char* name );
+
+unsigned long long int quadratic_error_scalar( unsigned char* original, unsigned char* destination, int length );
+
+unsigned long long int quadratic_error( cairo_surface_t* original, cairo_surface_t* destination );
+unsigned long long int quadratic_error_bounded( cairo_surface_t* original, cairo_surface_t* destination, unsigned long long int limit );
+unsigned long long int quadratic_error_region( cairo_surface_t* original, cairo_surface_t* destination, region_t* region );
+unsigned long long int quadratic_error_rows( cairo_surface_t* original, cairo_surface_t* destination, unsigned long long int* errors, int first, int step );
+
+#endif
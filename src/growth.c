@@ -0,0 +1,172 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <cairo.h>
+
+#include "random.h"
+#include "polygon.h"
+#include "fitness.h"
+#include "raster.h"
+#include "spatial.h"
+#include "incremental.h"
+#include "bands.h"
+#include "layers.h"
+#include "screen.h"
+#include "chain.h"
+#include "growth.h"
+
+static void find_residual( cairo_surface_t* original, polygons_t* polygons, region_t* cell );
+static void place_polygon( cairo_surface_t* original, polygons_t* polygons, int index, region_t* cell, rand_state_t* random );
+
+growth_t* initialize_growth( int target, unsigned int stall_iterations ) 
+{
+    growth_t* growth = malloc( sizeof( growth_t ) * sizeof( char ) );
+    growth->target           = target;
+    growth->stall_iterations = stall_iterations;
+    growth->added            = 0;
+    reset_growth( growth, 0 );
+    return growth;
+}
+
+void reset_growth( growth_t* growth, unsigned int iteration ) 
+{
+    // The fitness of a new chain is not comparable to the one before, like
+    // on another pyramid level. The next window only starts here.
+    growth->reference_fitness   = ULLONG_MAX;
+    growth->reference_iteration = iteration;
+}
+
+chain_t* grow_chain( growth_t* growth, chain_t* chain, unsigned int iteration, rand_state_t* random, chain_options_t* options ) 
+{
+    polygons_t* best;
+    polygons_t* grown;
+    chain_t* next;
+    region_t cell;
+
+    if ( chain->polygons->count >= growth->target || iteration - growth->reference_iteration < growth->stall_iterations ) 
+    {
+        return chain;
+    }
+    if ( chain->best_fitness < growth->reference_fitness * ( 1.0 - GROWTH_MIN_IMPROVEMENT ) ) 
+    {
+        growth->reference_fitness   = chain->best_fitness;
+        growth->reference_iteration = iteration;
+        return chain;
+    }
+
+    // Continue from the best state with a new polygon on top of the area it
+    // approximates worst
+    best = update_chain_best( chain );
+    find_residual( chain->original, best, &cell );
+    grown = resize_polygons( best, best->count + 1 );
+    place_polygon( chain->original, grown, best->count, &cell, random );
+
+    next = initialize_chain( chain->original, grown, chain->temperature, random, options );
+    next->benefitial = chain->benefitial;
+    next->annealing  = chain->annealing;
+    next->profile    = chain->profile;
+    free_chain( chain );
+
+    growth->reference_fitness   = next->best_fitness;
+    growth->reference_iteration = iteration;
+    ++growth->added;
+    return next;
+}
+
+void free_growth( growth_t* growth ) 
+{
+    free( growth );
+}
+
+static void find_residual( cairo_surface_t* original, polygons_t* polygons, region_t* cell ) 
+{
+    cairo_surface_t* render_surface = NULL;
+    unsigned long long int error, highest = 0;
+    int width  = cairo_image_surface_get_width( original );
+    int height = cairo_image_surface_get_height( original );
+    int i, j;
+
+    reset_render_surface( original, &render_surface, 0 );
+    render_polygons( render_surface, polygons );
+
+    // Cells of canvases smaller than the grid may be empty
+    cell->x0 = 0;
+    cell->y0 = 0;
+    cell->x1 = width;
+    cell->y1 = height;
+
+    for( j=0; j<GROWTH_GRID; ++j ) 
+    {
+        for( i=0; i<GROWTH_GRID; ++i ) 
+        {
+            region_t region = { width * i / GROWTH_GRID, height * j / GROWTH_GRID, width * ( i + 1 ) / GROWTH_GRID, height * ( j + 1 ) / GROWTH_GRID };
+            if ( region.x1 <= region.x0 || region.y1 <= region.y0 ) 
+            {
+                continue;
+            }
+            error = quadratic_error_region( original, render_surface, &region );
+            if ( error >= highest ) 
+            {
+                highest = error;
+                *cell   = region;
+            }
+        }
+    }
+
+    cairo_surface_destroy( render_surface );
+}
+
+static void place_polygon( cairo_surface_t* original, polygons_t* polygons, int index, region_t* cell, rand_state_t* random ) 
+{
+    unsigned char* data;
+    int stride = cairo_image_surface_get_stride( original );
+    unsigned long long int sum[3] = { 0, 0, 0 };
+    unsigned long long int pixels = ( cell->x1 - cell->x0 ) * ( cell->y1 - cell->y0 );
+    polygon_t polygon;
+    int x, y, i;
+
+    // Mean color of the cell. Pixels are stored as native endian ARGB32.
+    cairo_surface_flush( original );
+    data = cairo_image_surface_get_data( original );
+    for( y=cell->y0; y<cell->y1; ++y ) 
+    {
+        unsigned int* row = (unsigned int*)( data + y * stride );
+        for( x=cell->x0; x<cell->x1; ++x ) 
+        {
+            sum[0] += ( row[x] >> 16 ) & 0xff;
+            sum[1] += ( row[x] >> 8 ) & 0xff;
+            sum[2] += row[x] & 0xff;
+        }
+    }
+    for( i=0; i<3; ++i ) 
+    {
+        polygon.color[i] = sum[i] / pixels;
+    }
+    polygon.color[3] = GROWTH_ALPHA;
+
+    polygon.vertices = polygons->min_vertices < polygons->max_vertices ? rand_between( random, polygons->min_vertices, polygons->max_vertices ) : polygons->max_vertices;
+    for( i=0; i<polygon.vertices; ++i ) 
+    {
+        polygon.vertex[i].x = rand_between( random, cell->x0, cell->x1 );
+        polygon.vertex[i].y = rand_between( random, cell->y0, cell->y1 );
+    }
+    set_polygon( polygons, index, &polygon );
+}
@@ -0,0 +1,56 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef GROWTH_H
+#define GROWTH_H
+
+#define GROWTH_DEFAULT_STALL 1000
+
+// Relative improvement of the best fitness below which the annealing is
+// considered stalled
+#define GROWTH_MIN_IMPROVEMENT 0.001
+
+// New polygons are placed in the cell of a GROWTH_GRID x GROWTH_GRID grid
+// with the highest remaining error, in its mean color with this opacity
+#define GROWTH_GRID  8
+#define GROWTH_ALPHA 160
+
+// Starts a chain with a few polygons and adds one whenever the best fitness
+// stops improving, until the target count is reached
+typedef struct growth 
+{
+    int target;
+    unsigned int stall_iterations;
+
+    // Best fitness at the start of the current observation window
+    unsigned long long int reference_fitness;
+    unsigned int reference_iteration;
+
+    unsigned int added;
+} growth_t;
+
+growth_t* initialize_growth( int target, unsigned int stall_iterations );
+
+void reset_growth( growth_t* growth, unsigned int iteration );
+
+chain_t* grow_chain( growth_t* growth, chain_t* chain, unsigned int iteration, rand_state_t* random, chain_options_t* options );
+
+void free_growth( growth_t* growth );
+
+#endif
@@ -0,0 +1,110 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cairo.h>
+
+#include "image.h"
+
+cairo_surface_t* load_image_surface( char* filename ) 
+{
+    cairo_t* cr;
+    cairo_surface_t* surface;
+    cairo_surface_t* loaded_image = cairo_image_surface_create_from_png( filename );
+    if ( cairo_surface_status( loaded_image ) != CAIRO_STATUS_SUCCESS ) 
+    {
+        cairo_surface_destroy( loaded_image );
+        return NULL;
+    }    
+
+    // Make sure the input surface is 32bit ARGB. This is needed for the
+    // fitness comaprison to provide useful result values.
+    surface = cairo_image_surface_create( 
+        CAIRO_FORMAT_ARGB32,
+        cairo_image_surface_get_width( loaded_image ),
+        cairo_image_surface_get_height( loaded_image )
+    );
+    cr = cairo_create( surface );
+    cairo_set_source_surface( cr,
+        loaded_image,
+        .0,
+        .0       
+    );
+    cairo_paint( cr );
+    
+    cairo_destroy( cr );
+    cairo_surface_destroy( loaded_image );
+
+    return surface;
+}
+
+cairo_surface_t* create_image_surface( const unsigned char* pixels, int width, int height, int stride ) 
+{
+    // The pixels are premultiplied native endian ARGB32, just like a cairo
+    // image surface. They are copied row by row, as the strides may differ.
+    int y;
+    unsigned char* data;
+    int surface_stride;
+    cairo_surface_t* surface = cairo_image_surface_create( CAIRO_FORMAT_ARGB32, width, height );
+
+    if ( cairo_surface_status( surface ) != CAIRO_STATUS_SUCCESS ) 
+    {
+        cairo_surface_destroy( surface );
+        return NULL;
+    }
+
+    cairo_surface_flush( surface );
+    data           = cairo_image_surface_get_data( surface );
+    surface_stride = cairo_image_surface_get_stride( surface );
+    for( y=0; y<height; ++y ) 
+    {
+        memcpy( data + y * surface_stride, pixels + y * stride, width * 4 );
+    }
+    cairo_surface_mark_dirty( surface );
+
+    return surface;
+}
+
+int read_png_size( char* filename, int* width, int* height ) 
+{
+    // The size is stored in the IHDR chunk right after the signature, no
+    // need to decode the image for it
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    unsigned char header[24];
+    FILE* file;
+    int complete;
+
+    if ( ( file = fopen( filename, "rb" ) ) == NULL ) 
+    {
+        return 0;
+    }
+    complete = fread( header, 1, 24, file ) == 24;
+    fclose( file );
+
+    if ( !complete || memcmp( header, signature, 8 ) != 0 || memcmp( header + 12, "IHDR", 4 ) != 0 ) 
+    {
+        return 0;
+    }
+
+    *width  = ( header[16] << 24 ) | ( header[17] << 16 ) | ( header[18] << 8 ) | header[19];
+    *height = ( header[20] << 24 ) | ( header[21] << 16 ) | ( header[22] << 8 ) | header[23];
+    return 1;
+}
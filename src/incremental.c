@@ -0,0 +1,250 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cairo.h>
+
+#include "polygon.h"
+#include "fitness.h"
+#include "raster.h"
+#include "spatial.h"
+#include "incremental.h"
+
+static cairo_surface_t* create_incremental_surface( cairo_surface_t* original );
+static void copy_region( cairo_surface_t* source, cairo_surface_t* destination, region_t* region );
+static void tile_region( incremental_t* incremental, int tx, int ty, region_t* region );
+
+incremental_t* initialize_incremental( cairo_surface_t* original, polygons_t* polygons, int tile_size ) 
+{
+    int tx, ty;
+    region_t full;
+    incremental_t* incremental = malloc( sizeof( incremental_t ) * sizeof( char ) );
+
+    incremental->original  = original;
+    incremental->width     = cairo_image_surface_get_width( original );
+    incremental->height    = cairo_image_surface_get_height( original );
+    incremental->tile_size = tile_size;
+    incremental->spatial   = NULL;
+    incremental->tiles_x   = ( incremental->width + tile_size - 1 ) / tile_size;
+    incremental->tiles_y   = ( incremental->height + tile_size - 1 ) / tile_size;
+
+    incremental->tile_error = malloc( sizeof( unsigned long long int ) * incremental->tiles_x * incremental->tiles_y );
+    incremental->candidate_tile_error = malloc( sizeof( unsigned long long int ) * incremental->tiles_x * incremental->tiles_y );
+
+    incremental->current   = create_incremental_surface( original );
+    incremental->candidate = create_incremental_surface( original );
+    render_polygons( incremental->current, polygons );
+
+    full.x0 = 0;
+    full.y0 = 0;
+    full.x1 = incremental->width;
+    full.y1 = incremental->height;
+    copy_region( incremental->current, incremental->candidate, &full );
+
+    // Fill the error cache for the initial polygon set
+    incremental->fitness = 0;
+    for( ty=0; ty<incremental->tiles_y; ++ty ) 
+    {
+        for( tx=0; tx<incremental->tiles_x; ++tx ) 
+        {
+            region_t tile;
+            int index = ty * incremental->tiles_x + tx;
+            tile_region( incremental, tx, ty, &tile );
+            incremental->tile_error[index] = quadratic_error_region( original, incremental->current, &tile );
+            incremental->candidate_tile_error[index] = incremental->tile_error[index];
+            incremental->fitness += incremental->tile_error[index];
+        }
+    }
+
+    incremental->dirty.x0 = incremental->dirty.x1 = 0;
+    incremental->dirty.y0 = incremental->dirty.y1 = 0;
+
+    return incremental;
+}
+
+unsigned long long int evaluate_incremental( incremental_t* incremental, polygons_t* candidate, int polygon_number, polygon_t* previous, unsigned long long int limit ) 
+{
+    int tx, ty;
+    int tx0, ty0, tx1, ty1;
+    region_t changed;
+    unsigned long long int fitness = incremental->fitness;
+
+    // Only the area covered by the mutated polygon before or after the
+    // mutation may differ from the currently accepted rendering
+    polygon_bounding_box( previous, incremental->width, incremental->height, &incremental->dirty );
+    polygons_bounding_box( candidate, polygon_number, incremental->width, incremental->height, &changed );
+    region_union( &incremental->dirty, &changed );
+
+    if ( incremental->dirty.x0 >= incremental->dirty.x1 || incremental->dirty.y0 >= incremental->dirty.y1 ) 
+    {
+        return fitness;
+    }
+
+    // Grow the dirty region to the tile grid, so every touched tile is
+    // rescored completely
+    tx0 = incremental->dirty.x0 / incremental->tile_size;
+    ty0 = incremental->dirty.y0 / incremental->tile_size;
+    tx1 = ( incremental->dirty.x1 + incremental->tile_size - 1 ) / incremental->tile_size;
+    ty1 = ( incremental->dirty.y1 + incremental->tile_size - 1 ) / incremental->tile_size;
+    incremental->dirty.x0 = tx0 * incremental->tile_size;
+    incremental->dirty.y0 = ty0 * incremental->tile_size;
+    incremental->dirty.x1 = tx1 * incremental->tile_size > incremental->width ? incremental->width : tx1 * incremental->tile_size;
+    incremental->dirty.y1 = ty1 * incremental->tile_size > incremental->height ? incremental->height : ty1 * incremental->tile_size;
+
+    if ( incremental->spatial != NULL ) 
+    {
+        render_spatial_clipped( incremental->spatial, incremental->candidate, candidate, &incremental->dirty );
+    }
+    else 
+    {
+        render_polygons_clipped( incremental->candidate, candidate, &incremental->dirty );
+    }
+
+    // Remove the errors of all touched tiles first, so the fitness only
+    // grows while the new errors are added and the evaluation can stop once
+    // it exceeds the limit. Such a candidate is rejected afterwards.
+    for( ty=ty0; ty<ty1; ++ty ) 
+    {
+        for( tx=tx0; tx<tx1; ++tx ) 
+        {
+            fitness -= incremental->tile_error[ty * incremental->tiles_x + tx];
+        }
+    }
+
+    for( ty=ty0; ty<ty1; ++ty ) 
+    {
+        for( tx=tx0; tx<tx1; ++tx ) 
+        {
+            region_t tile;
+            int index = ty * incremental->tiles_x + tx;
+            tile_region( incremental, tx, ty, &tile );
+            incremental->candidate_tile_error[index] = quadratic_error_region( incremental->original, incremental->candidate, &tile );
+            fitness += incremental->candidate_tile_error[index];
+            if ( fitness > limit ) 
+            {
+                return fitness;
+            }
+        }
+    }
+
+    return fitness;
+}
+
+void accept_incremental( incremental_t* incremental ) 
+{
+    int tx, ty;
+    int tx0 = incremental->dirty.x0 / incremental->tile_size;
+    int ty0 = incremental->dirty.y0 / incremental->tile_size;
+    int tx1 = ( incremental->dirty.x1 + incremental->tile_size - 1 ) / incremental->tile_size;
+    int ty1 = ( incremental->dirty.y1 + incremental->tile_size - 1 ) / incremental->tile_size;
+
+    copy_region( incremental->candidate, incremental->current, &incremental->dirty );
+
+    for( ty=ty0; ty<ty1; ++ty ) 
+    {
+        for( tx=tx0; tx<tx1; ++tx ) 
+        {
+            int index = ty * incremental->tiles_x + tx;
+            incremental->fitness = incremental->fitness - incremental->tile_error[index] + incremental->candidate_tile_error[index];
+            incremental->tile_error[index] = incremental->candidate_tile_error[index];
+        }
+    }
+
+    incremental->dirty.x1 = incremental->dirty.x0;
+    incremental->dirty.y1 = incremental->dirty.y0;
+}
+
+void reject_incremental( incremental_t* incremental ) 
+{
+    // Restore the candidate surface to the accepted state. The candidate
+    // tile errors are simply overwritten by the next evaluation.
+    copy_region( incremental->current, incremental->candidate, &incremental->dirty );
+
+    incremental->dirty.x1 = incremental->dirty.x0;
+    incremental->dirty.y1 = incremental->dirty.y0;
+}
+
+void free_incremental( incremental_t* incremental ) 
+{
+    cairo_surface_destroy( incremental->current );
+    cairo_surface_destroy( incremental->candidate );
+    free( incremental->tile_error );
+    free( incremental->candidate_tile_error );
+    free( incremental );
+}
+
+static cairo_surface_t* create_incremental_surface( cairo_surface_t* original ) 
+{
+    cairo_surface_t* surface = cairo_surface_create_similar( 
+        original,
+        CAIRO_CONTENT_COLOR_ALPHA,
+        cairo_image_surface_get_width( original ),
+        cairo_image_surface_get_height( original )
+    );
+    if ( cairo_surface_status( surface ) != CAIRO_STATUS_SUCCESS ) 
+    {
+        printf( "Could not create incremental render surface.\n" );
+        exit( EXIT_FAILURE );
+    }
+    return surface;
+}
+
+static void copy_region( cairo_surface_t* source, cairo_surface_t* destination, region_t* region ) 
+{
+    int y;
+    int stride = cairo_image_surface_get_stride( source );
+    unsigned char* source_data;
+    unsigned char* destination_data;
+
+    if ( region->x0 >= region->x1 || region->y0 >= region->y1 ) 
+    {
+        return;
+    }
+
+    cairo_surface_flush( source );
+    cairo_surface_flush( destination );
+    source_data      = cairo_image_surface_get_data( source );
+    destination_data = cairo_image_surface_get_data( destination );
+
+    for( y=region->y0; y<region->y1; ++y ) 
+    {
+        memcpy( 
+            destination_data + y * stride + region->x0 * 4,
+            source_data + y * stride + region->x0 * 4,
+            ( region->x1 - region->x0 ) * 4
+        );
+    }
+
+    cairo_surface_mark_dirty_rectangle( destination,
+        region->x0,
+        region->y0,
+        region->x1 - region->x0,
+        region->y1 - region->y0
+    );
+}
+
+static void tile_region( incremental_t* incremental, int tx, int ty, region_t* region ) 
+{
+    region->x0 = tx * incremental->tile_size;
+    region->y0 = ty * incremental->tile_size;
+    region->x1 = region->x0 + incremental->tile_size > incremental->width ? incremental->width : region->x0 + incremental->tile_size;
+    region->y1 = region->y0 + incremental->tile_size > incremental->height ? incremental->height : region->y0 + incremental->tile_size;
+}
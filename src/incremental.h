@@ -0,0 +1,59 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#define INCREMENTAL_DEFAULT_TILE_SIZE 32
+
+// State needed to evaluate single polygon mutations without redrawing and
+// comparing the whole image. The canvas is split into square tiles, whose
+// quadratic errors are cached for the currently accepted polygon set.
+typedef struct incremental 
+{
+    cairo_surface_t* original;
+    cairo_surface_t* current;   // Rendering of the accepted polygons
+    cairo_surface_t* candidate; // Equals current outside of the dirty region
+
+    int width, height;
+    int tile_size;
+    int tiles_x, tiles_y;
+
+    unsigned long long int* tile_error;
+    unsigned long long int* candidate_tile_error;
+
+    // Tile aligned region touched by the last evaluated candidate
+    region_t dirty;
+
+    unsigned long long int fitness;
+
+    // Index of the candidate polygons used to skip the ones outside of the
+    // dirty region (NULL to draw all of them)
+    spatial_t* spatial;
+} incremental_t;
+
+incremental_t* initialize_incremental( cairo_surface_t* original, polygons_t* polygons, int tile_size );
+
+unsigned long long int evaluate_incremental( incremental_t* incremental, polygons_t* candidate, int polygon_number, polygon_t* previous, unsigned long long int limit );
+void accept_incremental( incremental_t* incremental );
+void reject_incremental( incremental_t* incremental );
+
+void free_incremental( incremental_t* incremental );
+
+#endif
@@ -0,0 +1,370 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cairo.h>
+
+#include "random.h"
+#include "polygon.h"
+#include "spatial.h"
+#include "incremental.h"
+#include "bands.h"
+#include "layers.h"
+#include "screen.h"
+#include "chain.h"
+#include "island.h"
+
+#define ISLAND_MAGIC "EVIS"
+
+// Slots start on their own cache lines
+#define ISLAND_ALIGNMENT 64
+
+// Time a process waits for another one to initialize the segment header
+#define ISLAND_STARTUP_POLLS 5000
+
+static unsigned long long int hash_image( cairo_surface_t* original );
+static size_t island_align( size_t size );
+static island_slot_t* island_slot( island_t* island, int index );
+static void claim_slot( island_t* island );
+static void publish_genome( island_t* island, polygons_t* polygons, unsigned long long int fitness );
+static int read_slot( island_t* island, int index, unsigned long long int* fitness );
+
+int island_policy( const char* name ) 
+{
+    if ( strcmp( name, "best" ) == 0 ) 
+    {
+        return ISLAND_POLICY_BEST;
+    }
+    if ( strcmp( name, "random" ) == 0 ) 
+    {
+        return ISLAND_POLICY_RANDOM;
+    }
+    if ( strcmp( name, "none" ) == 0 ) 
+    {
+        return ISLAND_POLICY_NONE;
+    }
+    printf( "Unknown island policy %s.\n", name );
+    exit( EXIT_FAILURE );
+}
+
+island_t* initialize_island( char* name, int slots, int policy, cairo_surface_t* original, polygons_t* polygons, rand_state_t* random ) 
+{
+    island_t* island = malloc( sizeof( island_t ) * sizeof( char ) );
+    size_t genome_size = POLYGON_GENOME_SIZE( polygons->max_vertices ) * polygons->count;
+    size_t slot_size   = island_align( sizeof( island_slot_t ) + genome_size );
+    unsigned long long int image_hash = hash_image( original );
+    struct stat info;
+    int polls;
+
+    // Shared memory object names start with a single slash
+    island->name = malloc( sizeof( char ) * ( strlen( name ) + 2 ) );
+    sprintf( island->name, "%s%s", name[0] == '/' ? "" : "/", name );
+    island->size = island_align( sizeof( island_header_t ) ) + slots * slot_size;
+
+    if ( ( island->fd = shm_open( island->name, O_RDWR | O_CREAT, 0600 ) ) == -1 || fstat( island->fd, &info ) != 0 ) 
+    {
+        printf( "Could not open island segment %s.\n", island->name );
+        exit( EXIT_FAILURE );
+    }
+    // Every process sizes a new segment the same way, a zero filled one is
+    // initialized by whoever gets to it first
+    if ( info.st_size == 0 && ftruncate( island->fd, island->size ) != 0 ) 
+    {
+        printf( "Could not size island segment %s.\n", island->name );
+        exit( EXIT_FAILURE );
+    }
+    if ( info.st_size != 0 && (size_t)info.st_size != island->size ) 
+    {
+        printf( "The island segment %s belongs to a run with different settings.\n", island->name );
+        exit( EXIT_FAILURE );
+    }
+    island->segment = mmap( NULL, island->size, PROT_READ | PROT_WRITE, MAP_SHARED, island->fd, 0 );
+    if ( island->segment == MAP_FAILED ) 
+    {
+        printf( "Could not map island segment %s.\n", island->name );
+        exit( EXIT_FAILURE );
+    }
+    island->header = (island_header_t*)island->segment;
+
+    if ( __sync_bool_compare_and_swap( &island->header->state, 0, 1 ) ) 
+    {
+        memcpy( island->header->magic, ISLAND_MAGIC, 4 );
+        island->header->slots         = slots;
+        island->header->polygon_count = polygons->count;
+        island->header->min_vertices  = polygons->min_vertices;
+        island->header->max_vertices  = polygons->max_vertices;
+        island->header->width         = polygons->original_width;
+        island->header->height        = polygons->original_height;
+        island->header->image_hash    = image_hash;
+        island->header->slot_size     = slot_size;
+        __atomic_store_n( &island->header->state, 2, __ATOMIC_RELEASE );
+    }
+    for( polls=0; __atomic_load_n( &island->header->state, __ATOMIC_ACQUIRE ) != 2; ++polls ) 
+    {
+        if ( polls == ISLAND_STARTUP_POLLS ) 
+        {
+            printf( "The island segment %s has not been initialized.\n", island->name );
+            exit( EXIT_FAILURE );
+        }
+        usleep( 1000 );
+    }
+
+    if ( memcmp( island->header->magic, ISLAND_MAGIC, 4 ) != 0 
+      || island->header->slots != slots 
+      || island->header->polygon_count != polygons->count 
+      || island->header->min_vertices != polygons->min_vertices 
+      || island->header->max_vertices != polygons->max_vertices 
+      || island->header->width != polygons->original_width 
+      || island->header->height != polygons->original_height 
+      || island->header->image_hash != image_hash 
+      || island->header->slot_size != slot_size ) 
+    {
+        printf( "The island segment %s belongs to a run with different settings.\n", island->name );
+        exit( EXIT_FAILURE );
+    }
+
+    island->policy            = policy;
+    island->published_fitness = ULLONG_MAX;
+    island->published         = 0;
+    island->adopted           = 0;
+    island->torn              = 0;
+    rand_split( random, &island->random );
+
+    island->buffer  = malloc( sizeof( unsigned char ) * genome_size );
+    island->migrant = malloc( sizeof( polygons_t ) * sizeof( char ) );
+    map_polygons( island->migrant, island->buffer, polygons->count, polygons->max_vertices );
+    island->migrant->min_vertices    = polygons->min_vertices;
+    island->migrant->original_width  = polygons->original_width;
+    island->migrant->original_height = polygons->original_height;
+
+    claim_slot( island );
+    printf( "Island %s: slot %d of %d\n", island->name, island->slot, slots );
+
+    return island;
+}
+
+chain_t* migrate_island( island_t* island, chain_t* chain, rand_state_t* random, chain_options_t* options ) 
+{
+    polygons_t* best = update_chain_best( chain );
+    unsigned long long int fitness = ULLONG_MAX;
+    int candidate = -1;
+    chain_t* adopted;
+    int i;
+
+    // Only improvements are published
+    if ( chain->best_fitness < island->published_fitness ) 
+    {
+        publish_genome( island, best, chain->best_fitness );
+    }
+
+    if ( island->policy == ISLAND_POLICY_BEST ) 
+    {
+        // The fitness is a single aligned word, it can be compared without
+        // copying the genomes
+        for( i=0; i<island->header->slots; ++i ) 
+        {
+            island_slot_t* slot = island_slot( island, i );
+            unsigned long long int slot_fitness = __atomic_load_n( &slot->fitness, __ATOMIC_RELAXED );
+            if ( i != island->slot && __atomic_load_n( &slot->generation, __ATOMIC_RELAXED ) != 0 && slot_fitness < fitness ) 
+            {
+                fitness   = slot_fitness;
+                candidate = i;
+            }
+        }
+    }
+    else if ( island->policy == ISLAND_POLICY_RANDOM && island->header->slots > 1 ) 
+    {
+        candidate = rand_between( &island->random, 0, island->header->slots - 2 );
+        candidate = candidate >= island->slot ? candidate + 1 : candidate;
+    }
+
+    if ( candidate < 0 || !read_slot( island, candidate, &fitness ) || fitness >= chain->current_fitness ) 
+    {
+        return chain;
+    }
+
+    // Continue from the migrant at the current temperature. The chain's
+    // own best state is kept if it is still better.
+    adopted = initialize_chain( chain->original, copy_polygons( island->migrant ), chain->temperature, random, options );
+    adopted->benefitial = chain->benefitial;
+    adopted->annealing  = chain->annealing;
+    adopted->profile    = chain->profile;
+    if ( chain->best_fitness < adopted->best_fitness ) 
+    {
+        copy_polygons_into( adopted->best_polygons, best );
+        adopted->best_fitness = chain->best_fitness;
+    }
+    free_chain( chain );
+
+    ++island->adopted;
+    return adopted;
+}
+
+void print_island_statistics( island_t* island ) 
+{
+    printf( "Island %s: slot %d, %llu published, %llu migrants adopted, %llu torn reads skipped\n", 
+        island->name, 
+        island->slot, 
+        island->published, 
+        island->adopted, 
+        island->torn 
+    );
+}
+
+void free_island( island_t* island ) 
+{
+    // The published genome stays in the segment for the other islands, only
+    // the slot is given up. The segment itself persists until it is removed.
+    __sync_bool_compare_and_swap( &island_slot( island, island->slot )->owner, getpid(), 0 );
+
+    munmap( island->segment, island->size );
+    close( island->fd );
+    free( island->buffer );
+    free( island->migrant );
+    free( island->name );
+    free( island );
+}
+
+static unsigned long long int hash_image( cairo_surface_t* original ) 
+{
+    // FNV-1a over the pixel rows
+    unsigned long long int hash = 14695981039346656037ULL;
+    unsigned char* data;
+    int width  = cairo_image_surface_get_width( original );
+    int height = cairo_image_surface_get_height( original );
+    int stride = cairo_image_surface_get_stride( original );
+    int x, y;
+
+    cairo_surface_flush( original );
+    data = cairo_image_surface_get_data( original );
+    for( y=0; y<height; ++y ) 
+    {
+        for( x=0; x<width * 4; ++x ) 
+        {
+            hash = ( hash ^ data[y * stride + x] ) * 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+static size_t island_align( size_t size ) 
+{
+    return ( size + ISLAND_ALIGNMENT - 1 ) / ISLAND_ALIGNMENT * ISLAND_ALIGNMENT;
+}
+
+static island_slot_t* island_slot( island_t* island, int index ) 
+{
+    return (island_slot_t*)( island->segment + island_align( sizeof( island_header_t ) ) + index * island->header->slot_size );
+}
+
+static void claim_slot( island_t* island ) 
+{
+    int i;
+    int self = getpid();
+
+    // Slots of processes which no longer exist are taken over, so crashed
+    // islands do not use up the segment
+    for( i=0; i<island->header->slots; ++i ) 
+    {
+        island_slot_t* slot = island_slot( island, i );
+        int owner = __atomic_load_n( &slot->owner, __ATOMIC_ACQUIRE );
+
+        if ( owner != 0 && ( kill( owner, 0 ) == 0 || errno != ESRCH ) ) 
+        {
+            continue;
+        }
+        if ( !__sync_bool_compare_and_swap( &slot->owner, owner, self ) ) 
+        {
+            continue;
+        }
+
+        // A writer which died while publishing left the sequence odd
+        if ( slot->sequence & 1 ) 
+        {
+            __atomic_store_n( &slot->sequence, slot->sequence + 1, __ATOMIC_RELEASE );
+        }
+        island->slot = i;
+        return;
+    }
+
+    printf( "All %d slots of island segment %s are taken.\n", island->header->slots, island->name );
+    exit( EXIT_FAILURE );
+}
+
+static void publish_genome( island_t* island, polygons_t* polygons, unsigned long long int fitness ) 
+{
+    island_slot_t* slot = island_slot( island, island->slot );
+    unsigned int sequence = slot->sequence;
+    polygons_t view;
+
+    __atomic_store_n( &slot->sequence, sequence + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+
+    map_polygons( &view, (unsigned char*)slot + sizeof( island_slot_t ), polygons->count, polygons->max_vertices );
+    copy_polygons_into( &view, polygons );
+    __atomic_store_n( &slot->fitness, fitness, __ATOMIC_RELAXED );
+    __atomic_store_n( &slot->generation, slot->generation + 1, __ATOMIC_RELAXED );
+
+    __atomic_store_n( &slot->sequence, sequence + 2, __ATOMIC_RELEASE );
+
+    island->published_fitness = fitness;
+    ++island->published;
+}
+
+static int read_slot( island_t* island, int index, unsigned long long int* fitness ) 
+{
+    island_slot_t* slot = island_slot( island, index );
+    int attempt;
+
+    for( attempt=0; attempt<ISLAND_READ_ATTEMPTS; ++attempt ) 
+    {
+        unsigned int sequence = __atomic_load_n( &slot->sequence, __ATOMIC_ACQUIRE );
+        unsigned long long int slot_fitness;
+
+        if ( sequence & 1 ) 
+        {
+            continue;
+        }
+        if ( __atomic_load_n( &slot->generation, __ATOMIC_RELAXED ) == 0 ) 
+        {
+            return 0;
+        }
+        memcpy( island->buffer, (unsigned char*)slot + sizeof( island_slot_t ), POLYGON_GENOME_SIZE( island->migrant->max_vertices ) * island->migrant->count );
+        slot_fitness = __atomic_load_n( &slot->fitness, __ATOMIC_RELAXED );
+
+        __atomic_thread_fence( __ATOMIC_ACQUIRE );
+        if ( __atomic_load_n( &slot->sequence, __ATOMIC_RELAXED ) == sequence ) 
+        {
+            *fitness = slot_fitness;
+            return 1;
+        }
+    }
+
+    ++island->torn;
+    return 0;
+}
@@ -0,0 +1,96 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef ISLAND_H
+#define ISLAND_H
+
+#define ISLAND_DEFAULT_SLOTS    8
+#define ISLAND_DEFAULT_INTERVAL 10000
+
+// Attempts to read a slot which is being written at the same time, before
+// it is skipped for this exchange
+#define ISLAND_READ_ATTEMPTS 4
+
+// Which migrant is considered for adoption
+enum 
+{
+    ISLAND_POLICY_BEST,   // The best genome of all other islands
+    ISLAND_POLICY_RANDOM, // The genome of a random other island
+    ISLAND_POLICY_NONE    // Publish only
+};
+
+// Fixed header at the start of the shared memory segment. Every process
+// checks that it anneals the same problem before joining.
+typedef struct island_header 
+{
+    char magic[4];
+    int state; // 0 while uninitialized, 1 while initializing, 2 when ready
+    int slots;
+    int polygon_count;
+    int min_vertices, max_vertices;
+    int width, height;
+    unsigned long long int image_hash;
+    unsigned long long int slot_size;
+} island_header_t;
+
+// Every process owns one slot and is its only writer. The sequence is odd
+// while the genome is written, readers retry or skip the slot if it changed
+// while they copied it. Nobody ever waits for another process.
+typedef struct island_slot 
+{
+    unsigned int sequence;
+    int owner; // Process id, 0 if free
+    unsigned long long int fitness;
+    unsigned long long int generation; // Number of publications, 0 if empty
+} island_slot_t;
+
+typedef struct island 
+{
+    char* name;
+    int fd;
+    size_t size;
+    unsigned char* segment;
+    island_header_t* header;
+
+    int slot;
+    int policy;
+
+    // Local copy of a migrant and the genome it is read into
+    unsigned char* buffer;
+    polygons_t* migrant;
+
+    unsigned long long int published_fitness;
+    rand_state_t random;
+
+    unsigned long long int published;
+    unsigned long long int adopted;
+    unsigned long long int torn;
+} island_t;
+
+int island_policy( const char* name );
+
+island_t* initialize_island( char* name, int slots, int policy, cairo_surface_t* original, polygons_t* polygons, rand_state_t* random );
+
+chain_t* migrate_island( island_t* island, chain_t* chain, rand_state_t* random, chain_options_t* options );
+
+void print_island_statistics( island_t* island );
+
+void free_island( island_t* island );
+
+#endif
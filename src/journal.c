@@ -0,0 +1,513 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cairo.h>
+
+#include "polygon.h"
+#include "journal.h"
+
+#define JOURNAL_BYTE_ORDER 0x01020304
+
+// Initial capacity of the record index of a reader
+#define JOURNAL_INITIAL_RECORDS 4096
+
+static unsigned char* load_journal( char* filename, journal_header_t* header, size_t* size );
+static int parse_record( journal_header_t* header, unsigned char* data, size_t size, size_t* offset, unsigned int* iteration, int* count, polygons_t* polygons );
+static int put_varint( unsigned char* buffer, unsigned int value );
+static int get_varint( unsigned char* data, size_t size, size_t* offset, unsigned int* value );
+static void write_journal( journal_t* journal, void* data, size_t length );
+
+journal_t* initialize_journal( char* filename, polygons_t* polygons, int polygon_count, int width, int height, int append ) 
+{
+    journal_t* journal = malloc( sizeof( journal_t ) * sizeof( char ) );
+    struct stat info;
+
+    memset( &journal->header, 0, sizeof( journal_header_t ) );
+    memcpy( journal->header.magic, JOURNAL_MAGIC, 4 );
+    journal->header.version       = JOURNAL_VERSION;
+    journal->header.byte_order    = JOURNAL_BYTE_ORDER;
+    journal->header.polygon_count = polygon_count;
+    journal->header.min_vertices  = polygons->min_vertices;
+    journal->header.max_vertices  = polygons->max_vertices;
+    journal->header.width         = width;
+    journal->header.height        = height;
+
+    journal->iteration = 0;
+    journal->records   = 0;
+    journal->keyframes = 0;
+    journal->bytes     = 0;
+
+    if ( append && stat( filename, &info ) == 0 ) 
+    {
+        // A resumed run continues the journal of the interrupted one. A
+        // record cut off by the interruption is dropped first.
+        journal_header_t existing;
+        size_t size;
+        size_t offset = sizeof( journal_header_t );
+        unsigned int iteration = 0;
+        int count = 0;
+        unsigned char* data = load_journal( filename, &existing, &size );
+
+        if ( memcmp( &existing, &journal->header, sizeof( journal_header_t ) ) != 0 ) 
+        {
+            printf( "The journal %s was written with different settings.\n", filename );
+            exit( EXIT_FAILURE );
+        }
+        while( parse_record( &existing, data, size, &offset, &iteration, &count, NULL ) );
+        free( data );
+
+        if ( truncate( filename, offset ) != 0 || ( journal->file = fopen( filename, "ab" ) ) == NULL ) 
+        {
+            printf( "Could not open journal %s.\n", filename );
+            exit( EXIT_FAILURE );
+        }
+        journal->iteration = iteration;
+        return journal;
+    }
+
+    if ( ( journal->file = fopen( filename, "wb" ) ) == NULL ) 
+    {
+        printf( "Could not open journal %s.\n", filename );
+        exit( EXIT_FAILURE );
+    }
+    write_journal( journal, &journal->header, sizeof( journal_header_t ) );
+    return journal;
+}
+
+void journal_keyframe( journal_t* journal, polygons_t* polygons, unsigned int iteration ) 
+{
+    unsigned char record[JOURNAL_RECORD_SIZE];
+    int length = 1;
+    int slots  = polygons->count * polygons->max_vertices;
+
+    record[0] = JOURNAL_KEYFRAME;
+    length += put_varint( record + length, iteration );
+    length += put_varint( record + length, polygons->original_width );
+    length += put_varint( record + length, polygons->original_height );
+    length += put_varint( record + length, polygons->count );
+    write_journal( journal, record, length );
+
+    // Same layout as the in memory genome block
+    write_journal( journal, polygons->x, sizeof( unsigned short ) * slots );
+    write_journal( journal, polygons->y, sizeof( unsigned short ) * slots );
+    write_journal( journal, polygons->color, sizeof( unsigned char ) * polygons->count * 4 );
+    write_journal( journal, polygons->vertices, sizeof( unsigned char ) * polygons->count );
+
+    // Keyframes are the points a reader can always recover from
+    if ( fflush( journal->file ) != 0 ) 
+    {
+        printf( "Could not write journal.\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    journal->iteration = iteration;
+    ++journal->records;
+    ++journal->keyframes;
+}
+
+void journal_mutation( journal_t* journal, polygons_t* polygons, int index, polygon_t* previous, unsigned int iteration ) 
+{
+    unsigned char record[JOURNAL_RECORD_SIZE];
+    int length = 1;
+    polygon_t polygon;
+    int i;
+
+    get_polygon( polygons, index, &polygon );
+    length += put_varint( record + length, iteration - journal->iteration );
+    length += put_varint( record + length, index );
+
+    // A step changes a single field of a single polygon, unless a vertex
+    // has been added or removed. Then the whole outline is stored.
+    if ( polygon.vertices != previous->vertices ) 
+    {
+        record[0] = JOURNAL_SHAPE;
+        length += put_varint( record + length, polygon.vertices );
+        for( i=0; i<polygon.vertices; ++i ) 
+        {
+            length += put_varint( record + length, polygon.vertex[i].x );
+            length += put_varint( record + length, polygon.vertex[i].y );
+        }
+    }
+    else 
+    {
+        for( i=0; i<polygon.vertices && polygon.vertex[i].x == previous->vertex[i].x && polygon.vertex[i].y == previous->vertex[i].y; ++i );
+        if ( i < polygon.vertices ) 
+        {
+            record[0] = JOURNAL_VERTEX;
+            length += put_varint( record + length, i );
+            length += put_varint( record + length, polygon.vertex[i].x );
+            length += put_varint( record + length, polygon.vertex[i].y );
+        }
+        else 
+        {
+            for( i=0; i<4 && polygon.color[i] == previous->color[i]; ++i );
+            if ( i == 4 ) 
+            {
+                // The mutation drew the value the field already had
+                return;
+            }
+            record[0] = JOURNAL_COLOR;
+            length += put_varint( record + length, i );
+            length += put_varint( record + length, polygon.color[i] );
+        }
+    }
+
+    write_journal( journal, record, length );
+    journal->iteration = iteration;
+    ++journal->records;
+}
+
+void print_journal_statistics( journal_t* journal ) 
+{
+    printf( "Journal: %llu records (%llu keyframes), %llu bytes\n", 
+        journal->records, 
+        journal->keyframes, 
+        journal->bytes 
+    );
+}
+
+void free_journal( journal_t* journal ) 
+{
+    if ( fclose( journal->file ) != 0 ) 
+    {
+        printf( "Could not write journal.\n" );
+    }
+    free( journal );
+}
+
+journal_reader_t* read_journal( char* filename ) 
+{
+    journal_reader_t* reader = malloc( sizeof( journal_reader_t ) * sizeof( char ) );
+    size_t offset = sizeof( journal_header_t );
+    unsigned int iteration = 0;
+    unsigned int cutoff;
+    int count = 0;
+    int capacity = JOURNAL_INITIAL_RECORDS;
+    int i;
+
+    reader->data       = load_journal( filename, &reader->header, &reader->size );
+    reader->offsets    = malloc( sizeof( size_t ) * capacity );
+    reader->iterations = malloc( sizeof( unsigned int ) * capacity );
+    reader->count      = 0;
+    reader->next       = 0;
+    reader->polygons   = NULL;
+
+    // Index the complete records. Anything after the last one has been cut
+    // off by an interrupted run.
+    while( 1 ) 
+    {
+        size_t start = offset;
+        if ( !parse_record( &reader->header, reader->data, reader->size, &offset, &iteration, &count, NULL ) ) 
+        {
+            break;
+        }
+        if ( reader->count == capacity ) 
+        {
+            capacity *= 2;
+            reader->offsets    = realloc( reader->offsets, sizeof( size_t ) * capacity );
+            reader->iterations = realloc( reader->iterations, sizeof( unsigned int ) * capacity );
+        }
+        reader->offsets[reader->count]    = start;
+        reader->iterations[reader->count] = iteration;
+        ++reader->count;
+    }
+    if ( offset != reader->size ) 
+    {
+        printf( "Ignoring %lu bytes of incomplete records at the end of %s.\n", (unsigned long)( reader->size - offset ), filename );
+    }
+    if ( reader->count == 0 || reader->data[reader->offsets[0]] != JOURNAL_KEYFRAME ) 
+    {
+        printf( "The journal %s does not contain any keyframe.\n", filename );
+        exit( EXIT_FAILURE );
+    }
+
+    // A resumed run starts with a keyframe at the iteration of its
+    // checkpoint. Records of the interrupted run from there on are replaced
+    // by the ones after it.
+    reader->superseded = malloc( sizeof( unsigned char ) * reader->count );
+    cutoff = reader->iterations[reader->count - 1] + 1;
+    for( i=reader->count - 1; i>=0; --i ) 
+    {
+        reader->superseded[i] = reader->iterations[i] >= cutoff;
+        if ( !reader->superseded[i] && reader->data[reader->offsets[i]] == JOURNAL_KEYFRAME && reader->iterations[i] < cutoff ) 
+        {
+            cutoff = reader->iterations[i];
+        }
+    }
+
+    reader->polygons = malloc( sizeof( polygons_t ) * sizeof( char ) );
+    map_polygons( reader->polygons, malloc( POLYGON_GENOME_SIZE( reader->header.max_vertices ) * sizeof( char ) * reader->header.polygon_count ), reader->header.polygon_count, reader->header.max_vertices );
+    reader->polygons->min_vertices = reader->header.min_vertices;
+
+    return reader;
+}
+
+int peek_journal( journal_reader_t* reader, unsigned int* iteration ) 
+{
+    while( reader->next < reader->count && reader->superseded[reader->next] ) 
+    {
+        ++reader->next;
+    }
+    if ( reader->next == reader->count ) 
+    {
+        return 0;
+    }
+    *iteration = reader->iterations[reader->next];
+    return 1;
+}
+
+int replay_journal( journal_reader_t* reader, unsigned int* iteration ) 
+{
+    size_t offset;
+    int count = reader->polygons->count;
+
+    if ( !peek_journal( reader, iteration ) ) 
+    {
+        return 0;
+    }
+    offset = reader->offsets[reader->next];
+    parse_record( &reader->header, reader->data, reader->size, &offset, iteration, &count, reader->polygons );
+    *iteration = reader->iterations[reader->next];
+    ++reader->next;
+    return 1;
+}
+
+void free_journal_reader( journal_reader_t* reader ) 
+{
+    free_polygons( reader->polygons );
+    free( reader->offsets );
+    free( reader->iterations );
+    free( reader->superseded );
+    free( reader->data );
+    free( reader );
+}
+
+static unsigned char* load_journal( char* filename, journal_header_t* header, size_t* size ) 
+{
+    unsigned char* data;
+    struct stat info;
+    int fd;
+
+    // Read the whole file at once and validate it afterwards
+    if ( ( fd = open( filename, O_RDONLY ) ) == -1 || fstat( fd, &info ) != 0 ) 
+    {
+        printf( "Could not open journal %s.\n", filename );
+        exit( EXIT_FAILURE );
+    }
+    data = malloc( sizeof( unsigned char ) * ( info.st_size + 1 ) );
+    if ( read( fd, data, info.st_size ) != (ssize_t)info.st_size ) 
+    {
+        printf( "Could not read journal %s.\n", filename );
+        exit( EXIT_FAILURE );
+    }
+    close( fd );
+
+    if ( (size_t)info.st_size < sizeof( journal_header_t ) || memcmp( data, JOURNAL_MAGIC, 4 ) != 0 ) 
+    {
+        printf( "%s is not a journal.\n", filename );
+        exit( EXIT_FAILURE );
+    }
+    memcpy( header, data, sizeof( journal_header_t ) );
+    if ( header->version != JOURNAL_VERSION 
+      || header->byte_order != JOURNAL_BYTE_ORDER 
+      || header->min_vertices < POLYGON_MIN_VERTICES 
+      || header->max_vertices > POLYGON_MAX_VERTICES 
+      || header->min_vertices > header->max_vertices 
+      || header->polygon_count <= 0 ) 
+    {
+        printf( "Journal %s was written by an incompatible version.\n", filename );
+        exit( EXIT_FAILURE );
+    }
+
+    *size = info.st_size;
+    return data;
+}
+
+static int parse_record( journal_header_t* header, unsigned char* data, size_t size, size_t* offset, unsigned int* iteration, int* count, polygons_t* polygons ) 
+{
+    // Decodes the record at offset and moves past it. The iteration and
+    // polygon count of the records before are updated to the ones of this
+    // record. The record is applied to the polygons, unless they are NULL.
+    // Their genome block must have room for the polygon count of the
+    // header. Incomplete or invalid records are not consumed.
+    size_t position = *offset;
+    unsigned int value, index, vertex, x, y, vertices, polygon_count;
+    int type, i;
+
+    if ( position >= size ) 
+    {
+        return 0;
+    }
+    type = data[position++];
+
+    if ( type == JOURNAL_KEYFRAME ) 
+    {
+        unsigned int width, height;
+        size_t genome_size;
+        if ( !get_varint( data, size, &position, &value ) 
+          || !get_varint( data, size, &position, &width ) 
+          || !get_varint( data, size, &position, &height ) 
+          || !get_varint( data, size, &position, &polygon_count ) 
+          || polygon_count == 0 
+          || polygon_count > (unsigned int)header->polygon_count ) 
+        {
+            return 0;
+        }
+        genome_size = POLYGON_GENOME_SIZE( header->max_vertices ) * polygon_count;
+        if ( size - position < genome_size ) 
+        {
+            return 0;
+        }
+        if ( polygons != NULL ) 
+        {
+            // The layout of the block depends on the count
+            map_polygons( polygons, polygons->x, polygon_count, header->max_vertices );
+            memcpy( polygons->x, data + position, genome_size );
+            polygons->min_vertices    = header->min_vertices;
+            polygons->original_width  = width;
+            polygons->original_height = height;
+        }
+        *iteration = value;
+        *count     = polygon_count;
+        *offset    = position + genome_size;
+        return 1;
+    }
+
+    if ( !get_varint( data, size, &position, &value ) 
+      || !get_varint( data, size, &position, &index ) 
+      || index >= (unsigned int)*count ) 
+    {
+        return 0;
+    }
+
+    switch( type ) 
+    {
+        case JOURNAL_VERTEX:
+            if ( !get_varint( data, size, &position, &vertex ) 
+              || !get_varint( data, size, &position, &x ) 
+              || !get_varint( data, size, &position, &y ) 
+              || vertex >= (unsigned int)header->max_vertices 
+              || x > POLYGON_MAX_COORDINATE 
+              || y > POLYGON_MAX_COORDINATE ) 
+            {
+                return 0;
+            }
+            if ( polygons != NULL ) 
+            {
+                POLYGON_X( polygons, index, vertex ) = x;
+                POLYGON_Y( polygons, index, vertex ) = y;
+            }
+        break;
+        case JOURNAL_COLOR:
+            if ( !get_varint( data, size, &position, &vertex ) 
+              || !get_varint( data, size, &position, &x ) 
+              || vertex >= 4 
+              || x > 255 ) 
+            {
+                return 0;
+            }
+            if ( polygons != NULL ) 
+            {
+                POLYGON_COLOR( polygons, index, vertex ) = x;
+            }
+        break;
+        case JOURNAL_SHAPE:
+            if ( !get_varint( data, size, &position, &vertices ) 
+              || vertices < (unsigned int)header->min_vertices 
+              || vertices > (unsigned int)header->max_vertices ) 
+            {
+                return 0;
+            }
+            for( i=0; i<(int)vertices; ++i ) 
+            {
+                if ( !get_varint( data, size, &position, &x ) 
+                  || !get_varint( data, size, &position, &y ) 
+                  || x > POLYGON_MAX_COORDINATE 
+                  || y > POLYGON_MAX_COORDINATE ) 
+                {
+                    return 0;
+                }
+                if ( polygons != NULL ) 
+                {
+                    POLYGON_X( polygons, index, i ) = x;
+                    POLYGON_Y( polygons, index, i ) = y;
+                }
+            }
+            if ( polygons != NULL ) 
+            {
+                polygons->vertices[index] = vertices;
+            }
+        break;
+        default:
+            return 0;
+    }
+
+    *iteration += value;
+    *offset     = position;
+    return 1;
+}
+
+static int put_varint( unsigned char* buffer, unsigned int value ) 
+{
+    int length = 0;
+    while( value >= 0x80 ) 
+    {
+        buffer[length++] = ( value & 0x7f ) | 0x80;
+        value >>= 7;
+    }
+    buffer[length++] = value;
+    return length;
+}
+
+static int get_varint( unsigned char* data, size_t size, size_t* offset, unsigned int* value ) 
+{
+    int shift;
+    *value = 0;
+    for( shift=0; shift<32; shift+=7 ) 
+    {
+        unsigned char byte;
+        if ( *offset >= size ) 
+        {
+            return 0;
+        }
+        byte = data[(*offset)++];
+        *value |= (unsigned int)( byte & 0x7f ) << shift;
+        if ( !( byte & 0x80 ) ) 
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void write_journal( journal_t* journal, void* data, size_t length ) 
+{
+    if ( fwrite( data, length, 1, journal->file ) != 1 ) 
+    {
+        printf( "Could not write journal.\n" );
+        exit( EXIT_FAILURE );
+    }
+    journal->bytes += length;
+}
@@ -0,0 +1,108 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#define JOURNAL_VERSION 2
+#define JOURNAL_MAGIC "EVJN"
+#define JOURNAL_FILENAME "journal.bin"
+#define JOURNAL_DEFAULT_KEYFRAMES 100000
+
+// Largest encoded record apart from keyframes: type, iteration, index,
+// vertex count and POLYGON_MAX_VERTICES coordinate pairs as varints
+#define JOURNAL_RECORD_SIZE ( 4 * 5 + 2 * POLYGON_MAX_VERTICES * 3 )
+
+// Every record starts with its type byte and the iteration of the step.
+// Keyframes store the iteration as is, followed by the canvas size, the
+// polygon count and the packed genome in native byte order. All other records store the
+// iteration relative to the record before and the polygon index. Numbers
+// are unsigned varints, 7 bits per byte, least significant first.
+enum 
+{
+    JOURNAL_KEYFRAME = 1, // width, height, count, genome
+    JOURNAL_VERTEX,       // vertex, x, y
+    JOURNAL_COLOR,        // channel, value
+    JOURNAL_SHAPE         // vertex count, x and y of every vertex
+};
+
+// Fixed size file header. The canvas is the one of the input image, all
+// states are rendered at this size. The polygon count is the largest one
+// of any keyframe.
+typedef struct journal_header 
+{
+    char magic[4];
+    unsigned int version;
+    unsigned int byte_order; // 0x01020304 as written by the machine
+    int polygon_count;
+    int min_vertices, max_vertices;
+    int width, height;
+} journal_header_t;
+
+// Append only log of the accepted mutations of a chain
+typedef struct journal 
+{
+    FILE* file;
+    journal_header_t header;
+    unsigned int iteration; // Of the last record
+
+    unsigned long long int records;
+    unsigned long long int keyframes;
+    unsigned long long int bytes;
+} journal_t;
+
+// Whole journal file in memory, replayed record by record. Records which
+// have been superseded by a later keyframe of a resumed run are skipped.
+typedef struct journal_reader 
+{
+    journal_header_t header;
+    unsigned char* data;
+    size_t size;
+
+    // Offset, iteration and validity of every complete record
+    size_t* offsets;
+    unsigned int* iterations;
+    unsigned char* superseded;
+    int count;
+    int next;
+
+    // State after the records replayed so far, NULL before the first
+    // keyframe
+    polygons_t* polygons;
+} journal_reader_t;
+
+journal_t* initialize_journal( char* filename, polygons_t* polygons, int polygon_count, int width, int height, int append );
+
+void journal_keyframe( journal_t* journal, polygons_t* polygons, unsigned int iteration );
+
+void journal_mutation( journal_t* journal, polygons_t* polygons, int index, polygon_t* previous, unsigned int iteration );
+
+void print_journal_statistics( journal_t* journal );
+
+void free_journal( journal_t* journal );
+
+journal_reader_t* read_journal( char* filename );
+
+int peek_journal( journal_reader_t* reader, unsigned int* iteration );
+
+int replay_journal( journal_reader_t* reader, unsigned int* iteration );
+
+void free_journal_reader( journal_reader_t* reader );
+
+#endif
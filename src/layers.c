@@ -0,0 +1,194 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cairo.h>
+
+#include "polygon.h"
+#include "fitness.h"
+#include "raster.h"
+#include "layers.h"
+
+static cairo_surface_t* create_layer_surface( int width, int height );
+static void copy_layer( cairo_surface_t* destination, cairo_surface_t* source );
+static void clear_layer( cairo_surface_t* surface );
+static void draw_group( layers_t* layers, cairo_surface_t* surface, polygons_t* polygons, int group );
+static void composite_layer( cairo_surface_t* destination, cairo_surface_t* source );
+static void update_below( layers_t* layers, polygons_t* polygons, int group );
+static void update_above( layers_t* layers, polygons_t* polygons, int group );
+
+layers_t* initialize_layers( cairo_surface_t* original, int polygon_count, int groups ) 
+{
+    int i;
+    layers_t* layers = malloc( sizeof( layers_t ) * sizeof( char ) );
+
+    if ( groups > polygon_count ) 
+    {
+        groups = polygon_count;
+    }
+
+    layers->original   = original;
+    layers->width      = cairo_image_surface_get_width( original );
+    layers->height     = cairo_image_surface_get_height( original );
+    layers->group_size = ( polygon_count + groups - 1 ) / groups;
+    layers->groups     = ( polygon_count + layers->group_size - 1 ) / layers->group_size;
+    layers->candidate  = create_layer_surface( layers->width, layers->height );
+    layers->below      = malloc( sizeof( cairo_surface_t* ) * layers->groups );
+    layers->above      = malloc( sizeof( cairo_surface_t* ) * layers->groups );
+
+    for( i=0; i<layers->groups; ++i ) 
+    {
+        layers->below[i] = create_layer_surface( layers->width, layers->height );
+        layers->above[i] = create_layer_surface( layers->width, layers->height );
+    }
+
+    // Nothing lies below the first or above the last group
+    layers->valid_below = 1;
+    layers->valid_above = layers->groups - 1;
+
+    return layers;
+}
+
+unsigned long long int evaluate_layers( layers_t* layers, polygons_t* candidate, int polygon_number, unsigned long long int limit ) 
+{
+    int group = polygon_number / layers->group_size;
+
+    // Only the mutated group differs from the accepted polygons, so the
+    // caches may be built from the candidate as well
+    update_below( layers, candidate, group );
+    update_above( layers, candidate, group );
+
+    copy_layer( layers->candidate, layers->below[group] );
+    draw_group( layers, layers->candidate, candidate, group );
+    if ( group < layers->groups - 1 ) 
+    {
+        composite_layer( layers->candidate, layers->above[group] );
+    }
+
+    return quadratic_error_bounded( layers->original, layers->candidate, limit );
+}
+
+void accept_layers( layers_t* layers, int polygon_number ) 
+{
+    int group = polygon_number / layers->group_size;
+
+    // Every composite containing the changed group is outdated
+    if ( layers->valid_below > group + 1 ) 
+    {
+        layers->valid_below = group + 1;
+    }
+    if ( layers->valid_above < group ) 
+    {
+        layers->valid_above = group;
+    }
+}
+
+void free_layers( layers_t* layers ) 
+{
+    int i;
+    for( i=0; i<layers->groups; ++i ) 
+    {
+        cairo_surface_destroy( layers->below[i] );
+        cairo_surface_destroy( layers->above[i] );
+    }
+    free( layers->below );
+    free( layers->above );
+    cairo_surface_destroy( layers->candidate );
+    free( layers );
+}
+
+static cairo_surface_t* create_layer_surface( int width, int height ) 
+{
+    cairo_surface_t* surface = cairo_image_surface_create( CAIRO_FORMAT_ARGB32, width, height );
+    if ( cairo_surface_status( surface ) != CAIRO_STATUS_SUCCESS ) 
+    {
+        printf( "Could not create layer surface.\n" );
+        exit( EXIT_FAILURE );
+    }
+    clear_layer( surface );
+    return surface;
+}
+
+static void copy_layer( cairo_surface_t* destination, cairo_surface_t* source ) 
+{
+    cairo_surface_flush( source );
+    cairo_surface_flush( destination );
+    memcpy( 
+        cairo_image_surface_get_data( destination ), 
+        cairo_image_surface_get_data( source ), 
+        cairo_image_surface_get_stride( source ) * cairo_image_surface_get_height( source ) 
+    );
+    cairo_surface_mark_dirty( destination );
+}
+
+static void clear_layer( cairo_surface_t* surface ) 
+{
+    cairo_surface_flush( surface );
+    memset( cairo_image_surface_get_data( surface ), 0, cairo_image_surface_get_stride( surface ) * cairo_image_surface_get_height( surface ) );
+    cairo_surface_mark_dirty( surface );
+}
+
+static void draw_group( layers_t* layers, cairo_surface_t* surface, polygons_t* polygons, int group ) 
+{
+    // Draw a slice of the polygons without copying them
+    polygons_t slice;
+    int first = group * layers->group_size;
+
+    slice_polygons( &slice, polygons, first, first + layers->group_size > polygons->count ? polygons->count - first : layers->group_size );
+
+    render_polygons( surface, &slice );
+}
+
+static void composite_layer( cairo_surface_t* destination, cairo_surface_t* source ) 
+{
+    cairo_t* cr = cairo_create( destination );
+    cairo_set_source_surface( cr, source, 0, 0 );
+    cairo_paint( cr );
+    cairo_destroy( cr );
+}
+
+static void update_below( layers_t* layers, polygons_t* polygons, int group ) 
+{
+    // Every composite is the previous one with one more group drawn on top
+    while( layers->valid_below <= group ) 
+    {
+        int i = layers->valid_below;
+        copy_layer( layers->below[i], layers->below[i - 1] );
+        draw_group( layers, layers->below[i], polygons, i - 1 );
+        ++layers->valid_below;
+    }
+}
+
+static void update_above( layers_t* layers, polygons_t* polygons, int group ) 
+{
+    // Every composite is the next group with the following composite on top
+    while( layers->valid_above > group ) 
+    {
+        int i = layers->valid_above - 1;
+        clear_layer( layers->above[i] );
+        draw_group( layers, layers->above[i], polygons, i + 1 );
+        if ( i + 1 < layers->groups - 1 ) 
+        {
+            composite_layer( layers->above[i], layers->above[i + 1] );
+        }
+        --layers->valid_above;
+    }
+}
@@ -0,0 +1,55 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef LAYERS_H
+#define LAYERS_H
+
+// Cached composites of consecutive polygon groups. A mutation only
+// changes the group of the mutated polygon, everything below and above it
+// is taken from the caches. The caches are valid for the accepted polygons
+// and rebuilt lazily once a mutation of another group has been accepted.
+typedef struct layers 
+{
+    cairo_surface_t* original;
+    cairo_surface_t* candidate;
+
+    int width, height;
+    int groups;
+    int group_size;
+
+    // Composite of all groups below (0..h-1) and above (h+1..groups-1) of
+    // every group h. The above composites are drawn on a transparent
+    // background.
+    cairo_surface_t** below;
+    cairo_surface_t** above;
+
+    // below[0..valid_below - 1] and above[valid_above..groups - 1] are up
+    // to date
+    int valid_below;
+    int valid_above;
+} layers_t;
+
+layers_t* initialize_layers( cairo_surface_t* original, int polygon_count, int groups );
+
+unsigned long long int evaluate_layers( layers_t* layers, polygons_t* candidate, int polygon_number, unsigned long long int limit );
+void accept_layers( layers_t* layers, int polygon_number );
+
+void free_layers( layers_t* layers );
+
+#endif
@@ -0,0 +1,246 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <cairo.h>
+
+#include "random.h"
+#include "polygon.h"
+#include "fitness.h"
+#include "raster.h"
+#include "spatial.h"
+#include "incremental.h"
+#include "bands.h"
+#include "layers.h"
+#include "screen.h"
+#include "chain.h"
+#include "image.h"
+#include "libevolver.h"
+
+#if EVOLVER_MAX_VERTICES != POLYGON_MAX_VERTICES
+    #error "EVOLVER_MAX_VERTICES has to match POLYGON_MAX_VERTICES"
+#endif
+
+struct evolver_context 
+{
+    cairo_surface_t* original;
+    chain_t* chain;
+    chain_options_t options;
+    rand_state_t random;
+
+    double alpha;
+    double epsilon;
+    unsigned int iteration;
+    int done;
+};
+
+static void select_defaults();
+static int valid_settings( int width, int height, evolver_settings_t* settings );
+
+static pthread_once_t defaults_once = PTHREAD_ONCE_INIT;
+
+void evolver_default_settings( evolver_settings_t* settings ) 
+{
+    // The same defaults as the commandline
+    settings->polygon_count         = 50;
+    settings->min_vertices          = POLYGON_DEFAULT_VERTICES;
+    settings->max_vertices          = POLYGON_DEFAULT_VERTICES;
+    settings->temperature           = 1000.0;
+    settings->alpha                 = 0.99999;
+    settings->epsilon               = 0.01;
+    settings->seed                  = rand_default_seed();
+    settings->in_place              = 0;
+    settings->incremental_tile_size = 0;
+    settings->bands                 = 0;
+    settings->layer_groups          = 0;
+    settings->cull                  = 0;
+    settings->screen                = 0;
+}
+
+evolver_context_t* evolver_create( const unsigned char* pixels, int width, int height, int stride, evolver_settings_t* settings ) 
+{
+    evolver_context_t* context;
+    cairo_surface_t* original;
+
+    if ( pixels == NULL || !valid_settings( width, height, settings ) ) 
+    {
+        return NULL;
+    }
+    if ( ( original = create_image_surface( pixels, width, height, stride ) ) == NULL ) 
+    {
+        return NULL;
+    }
+
+    pthread_once( &defaults_once, select_defaults );
+
+    context = malloc( sizeof( evolver_context_t ) * sizeof( char ) );
+    context->original                      = original;
+    context->options.in_place              = settings->in_place;
+    context->options.incremental_tile_size = settings->incremental_tile_size;
+    context->options.bands                 = settings->bands;
+    context->options.layer_groups          = settings->layer_groups;
+    context->options.cull                  = settings->cull;
+    context->options.screen                = settings->screen;
+    context->alpha                         = settings->alpha;
+    context->epsilon                       = settings->epsilon;
+    context->iteration                     = 0;
+    context->done                          = 0;
+
+    rand_seed( &context->random, settings->seed );
+    context->chain = initialize_chain( 
+        original, 
+        initialize_polygons( original, settings->polygon_count, settings->min_vertices, settings->max_vertices, &context->random ), 
+        settings->temperature, 
+        &context->random, 
+        &context->options 
+    );
+
+    return context;
+}
+
+unsigned int evolver_step( evolver_context_t* context, unsigned int iterations ) 
+{
+    // The loop of a single chain run without any output
+    unsigned int i;
+
+    for( i=0; i<iterations && !context->done; ++i ) 
+    {
+        step_chain( context->chain );
+        ++context->iteration;
+
+        if ( context->chain->temperature < context->epsilon ) 
+        {
+            measure_chain( context->chain );
+            context->done = 1;
+        }
+        else 
+        {
+            context->chain->temperature *= context->alpha;
+        }
+    }
+
+    return i;
+}
+
+int evolver_done( evolver_context_t* context ) 
+{
+    return context->done;
+}
+
+unsigned int evolver_iterations( evolver_context_t* context ) 
+{
+    return context->iteration;
+}
+
+double evolver_temperature( evolver_context_t* context ) 
+{
+    return context->chain->temperature;
+}
+
+unsigned long long int evolver_best_fitness( evolver_context_t* context ) 
+{
+    return context->done ? context->chain->exact_best_fitness : context->chain->best_fitness;
+}
+
+int evolver_best_genome( evolver_context_t* context, evolver_polygon_t* polygons, int capacity ) 
+{
+    polygons_t* best = update_chain_best( context->chain );
+    polygon_t polygon;
+    int i, j;
+
+    for( i=0; i<best->count && i<capacity; ++i ) 
+    {
+        get_polygon( best, i, &polygon );
+        polygons[i].vertices = polygon.vertices;
+        for( j=0; j<polygon.vertices; ++j ) 
+        {
+            polygons[i].x[j] = polygon.vertex[j].x;
+            polygons[i].y[j] = polygon.vertex[j].y;
+        }
+        for( j=0; j<4; ++j ) 
+        {
+            polygons[i].color[j] = polygon.color[j];
+        }
+    }
+
+    return best->count;
+}
+
+int evolver_render_best( evolver_context_t* context, unsigned char* pixels, int stride ) 
+{
+    cairo_surface_t* surface;
+    unsigned char* data;
+    int width  = cairo_image_surface_get_width( context->original );
+    int height = cairo_image_surface_get_height( context->original );
+    int y;
+
+    // Not reset_render_surface, which terminates the process if the
+    // surface can not be created
+    surface = cairo_image_surface_create( CAIRO_FORMAT_ARGB32, width, height );
+    if ( cairo_surface_status( surface ) != CAIRO_STATUS_SUCCESS ) 
+    {
+        cairo_surface_destroy( surface );
+        return 0;
+    }
+    render_polygons( surface, update_chain_best( context->chain ) );
+    cairo_surface_flush( surface );
+
+    data = cairo_image_surface_get_data( surface );
+    for( y=0; y<height; ++y ) 
+    {
+        memcpy( pixels + y * stride, data + y * cairo_image_surface_get_stride( surface ), width * 4 );
+    }
+
+    cairo_surface_destroy( surface );
+    return 1;
+}
+
+void evolver_destroy( evolver_context_t* context ) 
+{
+    free_chain( context->chain );
+    cairo_surface_destroy( context->original );
+    free( context );
+}
+
+static void select_defaults() 
+{
+    select_quadratic_error_kernel( NULL );
+    select_render_backend( NULL );
+}
+
+static int valid_settings( int width, int height, evolver_settings_t* settings ) 
+{
+    // The internal initialization stops the process on invalid values, so
+    // everything is checked up front
+    return width > 0 && height > 0 
+        && width <= POLYGON_MAX_COORDINATE && height <= POLYGON_MAX_COORDINATE 
+        && settings->polygon_count > 0 
+        && settings->min_vertices >= POLYGON_MIN_VERTICES 
+        && settings->max_vertices <= POLYGON_MAX_VERTICES 
+        && settings->min_vertices <= settings->max_vertices 
+        && settings->temperature > 0 
+        && settings->epsilon > 0 
+        && settings->alpha > 0 && settings->alpha < 1 
+        && settings->incremental_tile_size >= 0 
+        && settings->bands >= 0 
+        && settings->layer_groups >= 0;
+}
@@ -0,0 +1,98 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef LIBEVOLVER_H
+#define LIBEVOLVER_H
+
+// Embeddable interface to a single annealing run. Every context owns its
+// image, polygons, surfaces and random stream, so any number of contexts
+// may be used in one process, each one from a single thread at a time.
+// The error kernel and render backend are chosen once per process, when
+// the first context is created.
+//
+// Invalid arguments are reported through the return values. Resources
+// allocated by the annealing code itself, like the render, tile and layer
+// surfaces or the band threads, are treated like exhausted memory: if they
+// can not be created, a message is printed and the process terminates.
+// This may happen in evolver_create as well as in evolver_step.
+
+#define EVOLVER_MAX_VERTICES 8
+
+typedef struct evolver_context evolver_context_t;
+
+typedef struct evolver_settings 
+{
+    int polygon_count;
+    int min_vertices, max_vertices;
+
+    // Annealing schedule, the run is done once the temperature falls below
+    // epsilon
+    double temperature;
+    double alpha;
+    double epsilon;
+
+    unsigned long long int seed;
+
+    // Evaluation strategies, see the matching commandline options
+    int in_place;              // -u
+    int incremental_tile_size; // -i
+    int bands;                 // -b
+    int layer_groups;          // -g
+    int cull;                  // -C
+    int screen;                // -S
+} evolver_settings_t;
+
+// Polygon of a queried genome in pixel coordinates of the input image
+typedef struct evolver_polygon 
+{
+    int vertices;
+    int x[EVOLVER_MAX_VERTICES];
+    int y[EVOLVER_MAX_VERTICES];
+    unsigned char color[4]; // rgba
+} evolver_polygon_t;
+
+void evolver_default_settings( evolver_settings_t* settings );
+
+// The pixels are premultiplied native endian ARGB32 rows, stride bytes
+// apart, like a cairo image surface. They are copied, the buffer may be
+// released afterwards. Returns NULL if the settings or the size are
+// invalid, or the image can not be copied.
+evolver_context_t* evolver_create( const unsigned char* pixels, int width, int height, int stride, evolver_settings_t* settings );
+
+// Runs up to the given number of iterations and returns the number run,
+// which is smaller once the schedule is finished
+unsigned int evolver_step( evolver_context_t* context, unsigned int iterations );
+int evolver_done( evolver_context_t* context );
+
+unsigned int evolver_iterations( evolver_context_t* context );
+double evolver_temperature( evolver_context_t* context );
+// With layer groups the fitness is approximate until the run is done
+unsigned long long int evolver_best_fitness( evolver_context_t* context );
+
+// Copies up to capacity polygons of the best genome in drawing order and
+// returns the number of polygons of the genome
+int evolver_best_genome( evolver_context_t* context, evolver_polygon_t* polygons, int capacity );
+
+// Renders the best genome to an ARGB32 buffer of the input size. Returns 0
+// if no surface could be created for it.
+int evolver_render_best( evolver_context_t* context, unsigned char* pixels, int stride );
+
+void evolver_destroy( evolver_context_t* context );
+
+#endif
@@ -21,44 +21,202 @@
 #include <stdlib.h>
 #include <string.h>
 #include <cairo.h>
+#include <cairo-svg.h>
 
 #include "random.h"
 #include "polygon.h"
 
+typedef void (*bounding_box_kernel_t)( unsigned short* x, unsigned short* y, region_t* box );
+typedef void (*vertex_bounding_box_kernel_t)( vertex_t* vertex, region_t* box );
+
+static polygons_t* allocate_polygon_structure( int count, int max_vertices );
+static void clamp_bounding_box( region_t* box, int width, int height );
+static void insert_vertex( polygons_t* polygons, int index, rand_state_t* random );
+static void remove_vertex( polygons_t* polygons, int index, rand_state_t* random );
+
+// Bounding box of the packed coordinates of one polygon. A version is
+// generated for every vertex count, so each loop has a constant length.
+#define DEFINE_BOUNDING_BOX( n ) \
+static void bounding_box_##n( unsigned short* x, unsigned short* y, region_t* box ) \
+{ \
+    int i; \
+    box->x0 = box->x1 = x[0]; \
+    box->y0 = box->y1 = y[0]; \
+    for( i=1; i<n; ++i ) \
+    { \
+        if ( x[i] < box->x0 ) box->x0 = x[i]; \
+        if ( x[i] > box->x1 ) box->x1 = x[i]; \
+        if ( y[i] < box->y0 ) box->y0 = y[i]; \
+        if ( y[i] > box->y1 ) box->y1 = y[i]; \
+    } \
+}
+#define BOUNDING_BOX_ENTRY( n ) [n] = bounding_box_##n,
+
+// The same for the vertices of an unpacked polygon
+#define DEFINE_VERTEX_BOUNDING_BOX( n ) \
+static void vertex_bounding_box_##n( vertex_t* vertex, region_t* box ) \
+{ \
+    int i; \
+    box->x0 = box->x1 = vertex[0].x; \
+    box->y0 = box->y1 = vertex[0].y; \
+    for( i=1; i<n; ++i ) \
+    { \
+        if ( vertex[i].x < box->x0 ) box->x0 = vertex[i].x; \
+        if ( vertex[i].x > box->x1 ) box->x1 = vertex[i].x; \
+        if ( vertex[i].y < box->y0 ) box->y0 = vertex[i].y; \
+        if ( vertex[i].y > box->y1 ) box->y1 = vertex[i].y; \
+    } \
+}
+#define VERTEX_BOUNDING_BOX_ENTRY( n ) [n] = vertex_bounding_box_##n,
+
+POLYGON_SPECIALIZE( DEFINE_BOUNDING_BOX )
+POLYGON_SPECIALIZE( DEFINE_VERTEX_BOUNDING_BOX )
+
+static bounding_box_kernel_t bounding_box_kernels[POLYGON_MAX_VERTICES + 1] = {
+    POLYGON_SPECIALIZE( BOUNDING_BOX_ENTRY )
+};
+
+static vertex_bounding_box_kernel_t vertex_bounding_box_kernels[POLYGON_MAX_VERTICES + 1] = {
+    POLYGON_SPECIALIZE( VERTEX_BOUNDING_BOX_ENTRY )
+};
+
 polygons_t* copy_polygons( polygons_t* polygons )
 {
-    polygons_t* copy = allocate_polygon_structure( polygons->count );
+    polygons_t* copy = allocate_polygon_structure( polygons->count, polygons->max_vertices );
     copy->original_width   = polygons->original_width;
     copy->original_height = polygons->original_height;
-    memcpy( copy->polygon, polygons->polygon, sizeof( polygon_t ) * sizeof( char ) * polygons->count );    
+    copy_polygons_into( copy, polygons );
     return copy;
 }
 
-void draw_polygons( cairo_surface_t* surface, polygons_t* polygons ) 
+polygons_t* resize_polygons( polygons_t* polygons, int count ) 
+{
+    // The leading polygons are kept, added ones are cleared and have no
+    // vertices until they are set
+    polygons_t* resized = allocate_polygon_structure( count, polygons->max_vertices );
+    int i;
+
+    memset( resized->x, 0, POLYGON_GENOME_SIZE( polygons->max_vertices ) * sizeof( char ) * count );
+    resized->min_vertices    = polygons->min_vertices;
+    resized->original_width  = polygons->original_width;
+    resized->original_height = polygons->original_height;
+    for( i=0; i<count && i<polygons->count; ++i ) 
+    {
+        copy_polygon( resized, i, polygons, i );
+    }
+    return resized;
+}
+
+void copy_polygon( polygons_t* destination, int destination_index, polygons_t* source, int source_index ) 
+{
+    // Both polygons are expected to have room for the same number of
+    // vertices
+    int vertices = source->vertices[source_index];
+    memcpy( &POLYGON_X( destination, destination_index, 0 ), &POLYGON_X( source, source_index, 0 ), sizeof( unsigned short ) * vertices );
+    memcpy( &POLYGON_Y( destination, destination_index, 0 ), &POLYGON_Y( source, source_index, 0 ), sizeof( unsigned short ) * vertices );
+    memcpy( &POLYGON_COLOR( destination, destination_index, 0 ), &POLYGON_COLOR( source, source_index, 0 ), sizeof( unsigned char ) * 4 );
+    destination->vertices[destination_index] = vertices;
+}
+
+void copy_polygons_into( polygons_t* destination, polygons_t* source )
+{
+    // The destination is expected to be allocated for the same count and
+    // the same maximum number of vertices
+    destination->min_vertices    = source->min_vertices;
+    destination->original_width  = source->original_width;
+    destination->original_height = source->original_height;
+    // The arrays are copied one by one, as the source may be a slice of a
+    // larger genome
+    memcpy( destination->x, source->x, sizeof( unsigned short ) * source->max_vertices * source->count );
+    memcpy( destination->y, source->y, sizeof( unsigned short ) * source->max_vertices * source->count );
+    memcpy( destination->color, source->color, sizeof( unsigned char ) * 4 * source->count );
+    memcpy( destination->vertices, source->vertices, sizeof( unsigned char ) * source->count );
+}
+
+void map_polygons( polygons_t* polygons, void* genome, int count, int max_vertices ) 
+{
+    polygons->x            = (unsigned short*)genome;
+    polygons->y            = polygons->x + count * max_vertices;
+    polygons->color        = (unsigned char*)( polygons->y + count * max_vertices );
+    polygons->vertices     = polygons->color + count * 4;
+    polygons->min_vertices = max_vertices;
+    polygons->max_vertices = max_vertices;
+    polygons->count        = count;
+}
+
+void slice_polygons( polygons_t* slice, polygons_t* polygons, int first, int count ) 
+{
+    slice->x               = polygons->x + first * polygons->max_vertices;
+    slice->y               = polygons->y + first * polygons->max_vertices;
+    slice->color           = polygons->color + first * 4;
+    slice->vertices        = polygons->vertices + first;
+    slice->min_vertices    = polygons->min_vertices;
+    slice->max_vertices    = polygons->max_vertices;
+    slice->original_width  = polygons->original_width;
+    slice->original_height = polygons->original_height;
+    slice->count           = count;
+}
+
+void get_polygon( polygons_t* polygons, int index, polygon_t* polygon ) 
+{
+    int i;
+    polygon->vertices = polygons->vertices[index];
+    for( i=0; i<polygon->vertices; ++i ) 
+    {
+        polygon->vertex[i].x = POLYGON_X( polygons, index, i );
+        polygon->vertex[i].y = POLYGON_Y( polygons, index, i );
+    }
+    for( i=0; i<4; ++i ) 
+    {
+        polygon->color[i] = POLYGON_COLOR( polygons, index, i );
+    }
+}
+
+void set_polygon( polygons_t* polygons, int index, polygon_t* polygon ) 
+{
+    int i;
+    // Clear the slots the polygon no longer uses
+    for( i=polygon->vertices; i<polygons->vertices[index]; ++i ) 
+    {
+        POLYGON_X( polygons, index, i ) = 0;
+        POLYGON_Y( polygons, index, i ) = 0;
+    }
+    polygons->vertices[index] = polygon->vertices;
+    for( i=0; i<polygon->vertices; ++i ) 
+    {
+        POLYGON_X( polygons, index, i ) = polygon->vertex[i].x;
+        POLYGON_Y( polygons, index, i ) = polygon->vertex[i].y;
+    }
+    for( i=0; i<4; ++i ) 
+    {
+        POLYGON_COLOR( polygons, index, i ) = polygon->color[i];
+    }
+}
+
+static void draw_polygons_to_context( cairo_t* cr, polygons_t* polygons ) 
 {
     int i,j;
-    cairo_t* cr = cairo_create( surface );
     
     for( i=0; i<polygons->count; ++i ) 
     {
         cairo_save( cr );
         
         cairo_set_source_rgba( cr,
-            (double)(polygons->polygon[i].color[0]) / 255.0,
-            (double)(polygons->polygon[i].color[1]) / 255.0,
-            (double)(polygons->polygon[i].color[2]) / 255.0,
-            (double)(polygons->polygon[i].color[3]) / 255.0
+            (double)(POLYGON_COLOR( polygons, i, 0 )) / 255.0,
+            (double)(POLYGON_COLOR( polygons, i, 1 )) / 255.0,
+            (double)(POLYGON_COLOR( polygons, i, 2 )) / 255.0,
+            (double)(POLYGON_COLOR( polygons, i, 3 )) / 255.0
         );
         cairo_move_to( cr, 
-            polygons->polygon[i].vertex[POLYGON_VERTICES - 1].x,
-            polygons->polygon[i].vertex[POLYGON_VERTICES - 1].y
+            POLYGON_X( polygons, i, polygons->vertices[i] - 1 ),
+            POLYGON_Y( polygons, i, polygons->vertices[i] - 1 )
         );
         
-        for( j=0; j<POLYGON_VERTICES; ++j ) 
+        for( j=0; j<polygons->vertices[i]; ++j ) 
         {
             cairo_line_to( cr,
-                polygons->polygon[i].vertex[j].x,
-                polygons->polygon[i].vertex[j].y
+                POLYGON_X( polygons, i, j ),
+                POLYGON_Y( polygons, i, j )
             );
         }
         
@@ -66,6 +224,40 @@ void draw_polygons( cairo_surface_t* surface, polygons_t* polygons )
 
         cairo_restore( cr );
     }
+}
+
+void draw_polygons( cairo_surface_t* surface, polygons_t* polygons ) 
+{
+    cairo_t* cr = cairo_create( surface );
+    draw_polygons_to_context( cr, polygons );
+    cairo_destroy( cr );
+}
+
+void draw_polygons_clipped( cairo_surface_t* surface, polygons_t* polygons, region_t* region ) 
+{
+    cairo_t* cr;
+
+    if ( region->x0 >= region->x1 || region->y0 >= region->y1 ) 
+    {
+        return;
+    }
+
+    cr = cairo_create( surface );
+
+    // Restrict all drawing operations to the given region and clear it, so
+    // the polygon stack can be redrawn there from scratch
+    cairo_rectangle( cr, 
+        region->x0, 
+        region->y0, 
+        region->x1 - region->x0, 
+        region->y1 - region->y0 
+    );
+    cairo_clip( cr );
+    cairo_set_operator( cr, CAIRO_OPERATOR_CLEAR );
+    cairo_paint( cr );
+    cairo_set_operator( cr, CAIRO_OPERATOR_OVER );
+
+    draw_polygons_to_context( cr, polygons );
     
     cairo_destroy( cr );
 }
@@ -88,63 +280,214 @@ void draw_polygons_to_svg( polygons_t* polygons, char* filename )
     cairo_surface_destroy( svg_surface );
 }
 
-void evolve_polygons( polygons_t* polygons ) 
+void scale_polygons( polygons_t* polygons, int width, int height ) 
+{
+    int i;
+    for( i=0; i<polygons->count * polygons->max_vertices; ++i ) 
+    {
+        // Round to the nearest pixel of the new canvas
+        polygons->x[i] = (unsigned short)( ( (long long int)polygons->x[i] * width * 2 + polygons->original_width ) / ( polygons->original_width * 2 ) );
+        polygons->y[i] = (unsigned short)( ( (long long int)polygons->y[i] * height * 2 + polygons->original_height ) / ( polygons->original_height * 2 ) );
+    }
+    polygons->original_width  = width;
+    polygons->original_height = height;
+}
+
+int evolve_polygons( polygons_t* polygons, polygon_undo_t* undo, rand_state_t* random ) 
 {
-    int polygon_number = rand_between( 0, polygons->count - 1 );
+    int polygon_number = rand_between( random, 0, polygons->count - 1 );
+    int mutation_vertex;
+    if ( undo != NULL ) 
+    {
+        undo->index   = polygon_number;
+        get_polygon( polygons, polygon_number, &undo->polygon );
+    }
+    // With a range of vertex counts a vertex may be added or removed as
+    // well. Otherwise the same random numbers as with fixed counts are used.
+    if ( polygons->min_vertices < polygons->max_vertices ) 
+    {
+        int mutation = rand_between( random, 0, 3 );
+        int vertices = polygons->vertices[polygon_number];
+        if ( ( mutation == 2 && vertices < polygons->max_vertices ) 
+          || ( mutation == 3 && vertices == polygons->min_vertices ) ) 
+        {
+            insert_vertex( polygons, polygon_number, random );
+            return polygon_number;
+        }
+        if ( mutation >= 2 ) 
+        {
+            remove_vertex( polygons, polygon_number, random );
+            return polygon_number;
+        }
+        mutation_vertex = mutation;
+    }
+    else 
+    {
+        mutation_vertex = rand_between( random, 0, 1 );
+    }
+
     // Change vertices or color
-    if( rand_between( 0, 1 ) == 1 ) 
+    if( mutation_vertex == 1 ) 
     {
-        int vertex_number = rand_between( 0, POLYGON_VERTICES - 1 );
-        polygons->polygon[polygon_number].vertex[vertex_number].x = rand_between( 0, polygons->original_width );
-        polygons->polygon[polygon_number].vertex[vertex_number].y = rand_between( 0, polygons->original_height );
+        int vertex_number = rand_between( random, 0, polygons->vertices[polygon_number] - 1 );
+        POLYGON_X( polygons, polygon_number, vertex_number ) = rand_between( random, 0, polygons->original_width );
+        POLYGON_Y( polygons, polygon_number, vertex_number ) = rand_between( random, 0, polygons->original_height );
     }
     else 
     {
-        int color_number = rand_between( 0, 3 );
-        int color        = rand_between( 0, 255 );
+        int color_number = rand_between( random, 0, 3 );
+        int color        = rand_between( random, 0, 255 );
         // We don not want to create completely transparent polygons
         if ( color_number == 3 && color == 0 ) 
         {
             color = 1;
         }
-        polygons->polygon[polygon_number].color[color_number] = color;
+        POLYGON_COLOR( polygons, polygon_number, color_number ) = color;
     }
+    return polygon_number;
+}
+
+void undo_polygons( polygons_t* polygons, polygon_undo_t* undo ) 
+{
+    set_polygon( polygons, undo->index, &undo->polygon );
 }
 
-polygons_t* initialize_polygons( cairo_surface_t* original, int count ) 
+void polygon_bounding_box( polygon_t* polygon, int width, int height, region_t* box ) 
+{
+    vertex_bounding_box_kernels[polygon->vertices]( polygon->vertex, box );
+    clamp_bounding_box( box, width, height );
+}
+
+void polygons_bounding_box( polygons_t* polygons, int index, int width, int height, region_t* box ) 
+{
+    // Works on the packed coordinates directly, which are next to each
+    // other for every polygon
+    bounding_box_kernels[polygons->vertices[index]]( 
+        polygons->x + index * polygons->max_vertices, 
+        polygons->y + index * polygons->max_vertices, 
+        box 
+    );
+    clamp_bounding_box( box, width, height );
+}
+
+void region_union( region_t* region, region_t* other ) 
+{
+    if ( other->x0 >= other->x1 || other->y0 >= other->y1 ) 
+    {
+        return;
+    }
+    if ( region->x0 >= region->x1 || region->y0 >= region->y1 ) 
+    {
+        *region = *other;
+        return;
+    }
+    if ( other->x0 < region->x0 ) region->x0 = other->x0;
+    if ( other->y0 < region->y0 ) region->y0 = other->y0;
+    if ( other->x1 > region->x1 ) region->x1 = other->x1;
+    if ( other->y1 > region->y1 ) region->y1 = other->y1;
+}
+
+polygons_t* initialize_polygons( cairo_surface_t* original, int count, int min_vertices, int max_vertices, rand_state_t* random ) 
 {
     int i,j;
-    polygons_t* polygons = allocate_polygon_structure( count );
+    int color[4];
+    polygons_t* polygons;
 
+    if ( cairo_image_surface_get_width( original ) > POLYGON_MAX_COORDINATE 
+      || cairo_image_surface_get_height( original ) > POLYGON_MAX_COORDINATE ) 
+    {
+        printf( "Images larger than %i pixels in either direction are not supported.\n", POLYGON_MAX_COORDINATE );
+        exit( EXIT_FAILURE );
+    }
+
+    if ( min_vertices < POLYGON_MIN_VERTICES || max_vertices > POLYGON_MAX_VERTICES || min_vertices > max_vertices ) 
+    {
+        printf( "Polygons need between %i and %i vertices.\n", POLYGON_MIN_VERTICES, POLYGON_MAX_VERTICES );
+        exit( EXIT_FAILURE );
+    }
+
+    polygons = allocate_polygon_structure( count, max_vertices );
+    polygons->min_vertices = min_vertices;
     polygons->original_width = cairo_image_surface_get_width( original );
     polygons->original_height = cairo_image_surface_get_height( original );
     
+    // Unused vertex slots are cleared, so genomes compare and checksum
+    // equal regardless of their history
+    memset( polygons->x, 0, sizeof( unsigned short ) * 2 * max_vertices * count );
+    
     for( i=0; i<count; ++i ) 
     {
-        for( j=0; j<POLYGON_VERTICES; ++j ) 
+        polygons->vertices[i] = min_vertices < max_vertices ? rand_between( random, min_vertices, max_vertices ) : max_vertices;
+        for( j=0; j<polygons->vertices[i]; ++j ) 
         {
-            polygons->polygon[i].vertex[j].x = rand_between( 0, polygons->original_width );
-            polygons->polygon[i].vertex[j].y = rand_between( 0, polygons->original_height );
+            POLYGON_X( polygons, i, j ) = rand_between( random, 0, polygons->original_width );
+            POLYGON_Y( polygons, i, j ) = rand_between( random, 0, polygons->original_height );
         }
+        rand_fill_between( random, color, 4, 0, 255 );
         for( j=0; j<4; ++j ) 
         {
-            polygons->polygon[i].color[j] = rand_between( 0, 255 );
+            POLYGON_COLOR( polygons, i, j ) = color[j];
         }
     }
 
     return polygons;
 }
 
-static polygons_t* allocate_polygon_structure( int count ) 
+static polygons_t* allocate_polygon_structure( int count, int max_vertices ) 
 {
     polygons_t* p = malloc( sizeof( polygons_t ) * sizeof( char ) );
-    p->polygon = malloc( sizeof( polygon_t ) * sizeof( char ) * count );
-    p->count = count;
+    map_polygons( p, malloc( POLYGON_GENOME_SIZE( max_vertices ) * sizeof( char ) * count ), count, max_vertices );
     return p;
 }
 
+static void insert_vertex( polygons_t* polygons, int index, rand_state_t* random ) 
+{
+    // A new random vertex is placed between two existing ones
+    unsigned short* x = polygons->x + index * polygons->max_vertices;
+    unsigned short* y = polygons->y + index * polygons->max_vertices;
+    int vertices = polygons->vertices[index];
+    int position = rand_between( random, 0, vertices );
+    int i;
+
+    for( i=vertices; i>position; --i ) 
+    {
+        x[i] = x[i - 1];
+        y[i] = y[i - 1];
+    }
+    x[position] = rand_between( random, 0, polygons->original_width );
+    y[position] = rand_between( random, 0, polygons->original_height );
+    polygons->vertices[index] = vertices + 1;
+}
+
+static void remove_vertex( polygons_t* polygons, int index, rand_state_t* random ) 
+{
+    unsigned short* x = polygons->x + index * polygons->max_vertices;
+    unsigned short* y = polygons->y + index * polygons->max_vertices;
+    int vertices = polygons->vertices[index] - 1;
+    int position = rand_between( random, 0, vertices );
+    int i;
+
+    for( i=position; i<vertices; ++i ) 
+    {
+        x[i] = x[i + 1];
+        y[i] = y[i + 1];
+    }
+    x[vertices] = y[vertices] = 0;
+    polygons->vertices[index] = vertices;
+}
+
+static void clamp_bounding_box( region_t* box, int width, int height ) 
+{
+    // Antialiasing may touch the pixels surrounding the outline. Therefore a
+    // safety margin of one pixel is added before clamping to the canvas.
+    box->x0 = box->x0 - 1 < 0 ? 0 : box->x0 - 1;
+    box->y0 = box->y0 - 1 < 0 ? 0 : box->y0 - 1;
+    box->x1 = box->x1 + 1 > width ? width : box->x1 + 1;
+    box->y1 = box->y1 + 1 > height ? height : box->y1 + 1;
+}
+
 void free_polygons( polygons_t* polygons ) 
 {
-    free( polygons->polygon );
+    free( polygons->x );
     free( polygons );
 }
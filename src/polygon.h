@@ -20,39 +20,99 @@
 #ifndef POLYGON_H
 #define POLYGON_H
 
-#define POLYGON_VERTICES 6
+#include "random.h"
+
+// Range of vertex counts a polygon may have. Every count in between has
+// its own specialized routines, listed by POLYGON_SPECIALIZE.
+#define POLYGON_MIN_VERTICES 3
+#define POLYGON_MAX_VERTICES 8
+#define POLYGON_DEFAULT_VERTICES 6
+
+// Expands the given macro once for every supported vertex count
+#define POLYGON_SPECIALIZE( macro ) macro( 3 ) macro( 4 ) macro( 5 ) macro( 6 ) macro( 7 ) macro( 8 )
 
 //#define POLYGON_COUNT 5
 
+// Largest canvas edge a 16 bit coordinate can address
+#define POLYGON_MAX_COORDINATE 65535
+
 typedef struct vertex 
 {
     int x, y;
 } vertex_t;
 
+// Unpacked copy of a single polygon, used wherever one polygon is worked
+// on as a whole, like the rasterizer or the undo information
 typedef struct polygon
 {
-    vertex_t vertex[POLYGON_VERTICES];
+    vertex_t vertex[POLYGON_MAX_VERTICES];
+    int vertices;
     int color[4]; // rgba
 } polygon_t;
 
+// The genome is stored as structure of arrays in one contiguous block: all
+// x coordinates, followed by all y coordinates, followed by all rgba
+// colors and the vertex count of every polygon. Each polygon reserves room
+// for max_vertices coordinates, of which the first vertices[i] are used.
 typedef struct polygons 
 {
-    polygon_t *polygon;
+    unsigned short* x;
+    unsigned short* y;
+    unsigned char* color;
+    unsigned char* vertices;
+    int min_vertices, max_vertices;
     int original_width, original_height;
     int count;
 } polygons_t;
 
+#define POLYGON_X( polygons, index, vertex ) ( (polygons)->x[(index) * (polygons)->max_vertices + (vertex)] )
+#define POLYGON_Y( polygons, index, vertex ) ( (polygons)->y[(index) * (polygons)->max_vertices + (vertex)] )
+#define POLYGON_COLOR( polygons, index, channel ) ( (polygons)->color[(index) * 4 + (channel)] )
+
+// Bytes needed by the genome of a single polygon with room for the given
+// number of vertices
+#define POLYGON_GENOME_SIZE( max_vertices ) ( 2 * (max_vertices) * sizeof( unsigned short ) + 4 * sizeof( unsigned char ) + sizeof( unsigned char ) )
+
+// Everything needed to revert a single evolve_polygons step
+typedef struct polygon_undo 
+{
+    int index;
+    polygon_t polygon;
+} polygon_undo_t;
+
+// Axis aligned pixel rectangle. The upper bounds are exclusive.
+typedef struct region
+{
+    int x0, y0;
+    int x1, y1;
+} region_t;
+
 
-polygons_t* initialize_polygons( cairo_surface_t* original, int count ); 
+polygons_t* initialize_polygons( cairo_surface_t* original, int count, int min_vertices, int max_vertices, rand_state_t* random ); 
 
 void draw_polygons( cairo_surface_t* surface, polygons_t* polygons );
+void draw_polygons_clipped( cairo_surface_t* surface, polygons_t* polygons, region_t* region );
 void draw_polygons_to_svg( polygons_t* polygons, char* filename );
 
-void evolve_polygons( polygons_t* polygons );
+int evolve_polygons( polygons_t* polygons, polygon_undo_t* undo, rand_state_t* random );
+void undo_polygons( polygons_t* polygons, polygon_undo_t* undo );
+
+void get_polygon( polygons_t* polygons, int index, polygon_t* polygon );
+void set_polygon( polygons_t* polygons, int index, polygon_t* polygon );
+
+void polygon_bounding_box( polygon_t* polygon, int width, int height, region_t* box );
+void polygons_bounding_box( polygons_t* polygons, int index, int width, int height, region_t* box );
+void region_union( region_t* region, region_t* other );
+
+void map_polygons( polygons_t* polygons, void* genome, int count, int max_vertices );
+void slice_polygons( polygons_t* slice, polygons_t* polygons, int first, int count );
 
+void copy_polygon( polygons_t* destination, int destination_index, polygons_t* source, int source_index );
 polygons_t* copy_polygons( polygons_t* polygons );
+polygons_t* resize_polygons( polygons_t* polygons, int count );
+void copy_polygons_into( polygons_t* destination, polygons_t* source );
 
-static polygons_t* allocate_polygon_structure( int count );
+void scale_polygons( polygons_t* polygons, int width, int height );
 
 void free_polygons( polygons_t* polygons );
 
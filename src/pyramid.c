@@ -0,0 +1,113 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <cairo.h>
+
+#include "pyramid.h"
+
+static cairo_surface_t* downsample( cairo_surface_t* source );
+
+pyramid_t* initialize_pyramid( cairo_surface_t* original, int levels ) 
+{
+    int i;
+    pyramid_t* pyramid = malloc( sizeof( pyramid_t ) * sizeof( char ) );
+
+    levels = levels < 1 ? 1 : levels;
+
+    pyramid->levels   = levels;
+    pyramid->surfaces = malloc( sizeof( cairo_surface_t* ) * levels );
+    pyramid->surfaces[0] = cairo_surface_reference( original );
+
+    for( i=1; i<levels; ++i ) 
+    {
+        // Stop early, if the image can not be reduced any further
+        if ( cairo_image_surface_get_width( pyramid->surfaces[i - 1] ) < 2 
+          || cairo_image_surface_get_height( pyramid->surfaces[i - 1] ) < 2 ) 
+        {
+            pyramid->levels = i;
+            break;
+        }
+        pyramid->surfaces[i] = downsample( pyramid->surfaces[i - 1] );
+    }
+
+    return pyramid;
+}
+
+double pyramid_pixel_ratio( pyramid_t* pyramid, int level ) 
+{
+    return (double)( cairo_image_surface_get_width( pyramid->surfaces[level] ) * cairo_image_surface_get_height( pyramid->surfaces[level] ) )
+         / (double)( cairo_image_surface_get_width( pyramid->surfaces[0] ) * cairo_image_surface_get_height( pyramid->surfaces[0] ) );
+}
+
+void free_pyramid( pyramid_t* pyramid ) 
+{
+    int i;
+    for( i=0; i<pyramid->levels; ++i ) 
+    {
+        cairo_surface_destroy( pyramid->surfaces[i] );
+    }
+    free( pyramid->surfaces );
+    free( pyramid );
+}
+
+static cairo_surface_t* downsample( cairo_surface_t* source ) 
+{
+    int x, y, c;
+    int source_width  = cairo_image_surface_get_width( source );
+    int source_height = cairo_image_surface_get_height( source );
+    int source_stride = cairo_image_surface_get_stride( source );
+    int width  = ( source_width + 1 ) / 2;
+    int height = ( source_height + 1 ) / 2;
+    unsigned char *source_data, *data;
+    int stride;
+    cairo_surface_t* surface = cairo_image_surface_create( CAIRO_FORMAT_ARGB32, width, height );
+
+    if ( cairo_surface_status( surface ) != CAIRO_STATUS_SUCCESS ) 
+    {
+        printf( "Could not create pyramid surface.\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    cairo_surface_flush( source );
+    source_data = cairo_image_surface_get_data( source );
+    data        = cairo_image_surface_get_data( surface );
+    stride      = cairo_image_surface_get_stride( surface );
+
+    // Average 2x2 blocks of premultiplied pixels. Odd borders reuse their
+    // last row or column.
+    for( y=0; y<height; ++y ) 
+    {
+        unsigned char* top    = source_data + ( 2 * y ) * source_stride;
+        unsigned char* bottom = source_data + ( 2 * y + 1 < source_height ? 2 * y + 1 : 2 * y ) * source_stride;
+        for( x=0; x<width; ++x ) 
+        {
+            int left  = 2 * x * 4;
+            int right = ( 2 * x + 1 < source_width ? 2 * x + 1 : 2 * x ) * 4;
+            for( c=0; c<4; ++c ) 
+            {
+                data[y * stride + x * 4 + c] = ( top[left + c] + top[right + c] + bottom[left + c] + bottom[right + c] + 2 ) / 4;
+            }
+        }
+    }
+
+    cairo_surface_mark_dirty( surface );
+    return surface;
+}
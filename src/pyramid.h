@@ -0,0 +1,37 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+// Downsampled copies of an image. Level 0 is the original image, every
+// further level has half the width and height of the previous one.
+typedef struct pyramid 
+{
+    int levels;
+    cairo_surface_t** surfaces;
+} pyramid_t;
+
+pyramid_t* initialize_pyramid( cairo_surface_t* original, int levels );
+
+double pyramid_pixel_ratio( pyramid_t* pyramid, int level );
+
+void free_pyramid( pyramid_t* pyramid );
+
+#endif
@@ -23,23 +23,138 @@
 
 #include "random.h"
 
-void rand_seed() 
+static inline unsigned long long int rotate_left( unsigned long long int value, int bits ) 
 {
-    srand( time( 0 ) );
+    return ( value << bits ) | ( value >> ( 64 - bits ) );
 }
 
-int rand_between( int start, int end ) 
+static unsigned long long int splitmix64( unsigned long long int* value ) 
 {
-    int randval = (int)(rand_double_between( start, end ));
-    return randval;
+    unsigned long long int z = ( *value += 0x9e3779b97f4a7c15ULL );
+    z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+    z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+    return z ^ ( z >> 31 );
 }
 
-double rand_double_between( int start, int end ) 
+unsigned long long int rand_default_seed() 
 {
-    return ( ( rand_double() * (double)( end - start + 1 ) ) + (double)(start) );
+    return (unsigned long long int)time( 0 );
 }
 
-double rand_double() 
+void rand_seed( rand_state_t* state, unsigned long long int seed ) 
 {
-    return ( (double)rand() / ( (double)(RAND_MAX) + (double)(1) ) );
+    // Expand the seed with splitmix64, which never yields the invalid all
+    // zero state
+    int i;
+    for( i=0; i<4; ++i ) 
+    {
+        state->s[i] = splitmix64( &seed );
+    }
+}
+
+void rand_split( rand_state_t* state, rand_state_t* stream ) 
+{
+    // Hand the current sequence to the new stream and jump 2^128 steps
+    // ahead, so both never overlap
+    static const unsigned long long int jump[] = { 
+        0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL 
+    };
+    unsigned long long int s[4] = { 0, 0, 0, 0 };
+    int i, b;
+
+    *stream = *state;
+
+    for( i=0; i<4; ++i ) 
+    {
+        for( b=0; b<64; ++b ) 
+        {
+            if ( jump[i] & ( 1ULL << b ) ) 
+            {
+                s[0] ^= state->s[0];
+                s[1] ^= state->s[1];
+                s[2] ^= state->s[2];
+                s[3] ^= state->s[3];
+            }
+            rand_next( state );
+        }
+    }
+
+    state->s[0] = s[0];
+    state->s[1] = s[1];
+    state->s[2] = s[2];
+    state->s[3] = s[3];
+}
+
+unsigned long long int rand_next( rand_state_t* state ) 
+{
+    unsigned long long int* s = state->s;
+    unsigned long long int result = rotate_left( s[1] * 5, 7 ) * 9;
+    unsigned long long int t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotate_left( s[3], 45 );
+
+    return result;
+}
+
+int rand_between( rand_state_t* state, int start, int end ) 
+{
+    // Both bounds are inclusive. The upper half of a random value is
+    // multiplied into the range, values of the biased remainder are
+    // rejected (Lemire's method).
+    unsigned int range = (unsigned int)( end - start ) + 1;
+    unsigned long long int product = ( rand_next( state ) >> 32 ) * range;
+
+    if ( (unsigned int)product < range ) 
+    {
+        unsigned int threshold = -range % range;
+        while( (unsigned int)product < threshold ) 
+        {
+            product = ( rand_next( state ) >> 32 ) * range;
+        }
+    }
+
+    return start + (int)( product >> 32 );
+}
+
+double rand_double( rand_state_t* state ) 
+{
+    // 53 random bits in [0, 1)
+    return (double)( rand_next( state ) >> 11 ) * ( 1.0 / 9007199254740992.0 );
+}
+
+void rand_fill_between( rand_state_t* state, int* values, int count, int start, int end ) 
+{
+    // Both 32 bit halves of a random value are multiplied into the range
+    // in turn, with the same rejection as in rand_between. The output of
+    // xoshiro256** is fully scrambled, its lower half is as good as the
+    // upper one.
+    unsigned int range     = (unsigned int)( end - start ) + 1;
+    unsigned int threshold = -range % range;
+    unsigned long long int value = 0;
+    int halves = 0;
+    int i = 0;
+
+    while( i < count ) 
+    {
+        unsigned long long int product;
+
+        if ( halves == 0 ) 
+        {
+            value  = rand_next( state );
+            halves = 2;
+        }
+        product = ( value >> 32 ) * range;
+        value <<= 32;
+        --halves;
+
+        if ( (unsigned int)product >= threshold ) 
+        {
+            values[i++] = start + (int)( product >> 32 );
+        }
+    }
 }
@@ -20,11 +20,25 @@
 #ifndef RANDOM_H
 #define RANDOM_H
 
-void rand_seed();
+// State of a xoshiro256** generator. Every thread works on its own state,
+// nothing is shared between them.
+typedef struct rand_state 
+{
+    unsigned long long int s[4];
+} rand_state_t;
 
-int rand_between( int start, int end );
+unsigned long long int rand_default_seed();
 
-double rand_double_between( int start, int end );
-double rand_double();
+void rand_seed( rand_state_t* state, unsigned long long int seed );
+void rand_split( rand_state_t* state, rand_state_t* stream );
+
+unsigned long long int rand_next( rand_state_t* state );
+
+int rand_between( rand_state_t* state, int start, int end );
+double rand_double( rand_state_t* state );
+
+// Like count calls of rand_between, but every generated value is used for
+// two results
+void rand_fill_between( rand_state_t* state, int* values, int count, int start, int end );
 
 #endif
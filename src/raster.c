@@ -0,0 +1,597 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <cairo.h>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+#include "polygon.h"
+#include "raster.h"
+
+// Size of the canvas and number of polygons used to validate the scanline
+// rasterizer against cairo
+#define RASTER_VALIDATION_WIDTH    97
+#define RASTER_VALIDATION_HEIGHT   83
+#define RASTER_VALIDATION_POLYGONS 40
+
+typedef struct render_backend 
+{
+    const char* name;
+    void (*draw)( cairo_surface_t* surface, polygons_t* polygons );
+    void (*draw_clipped)( cairo_surface_t* surface, polygons_t* polygons, region_t* region );
+} render_backend_t;
+
+typedef struct raster_edge 
+{
+    int top, bottom;     // First and one past the last crossed sub-scanline
+    long long int x, dx; // 16.16 fixed point position and step per sub-scanline
+    int direction;
+} raster_edge_t;
+
+// Coverage accumulation buffers for one pixel row. Partially covered pixels
+// are added to cover directly, fully covered runs are stored as start and
+// end markers in delta, which are resolved once per row. The buffers are
+// kept with every surface and are all zero between rows, as blend_row
+// clears the span it resolved.
+typedef struct raster_row 
+{
+    int* cover;
+    int* delta;
+} raster_row_t;
+
+// Premultiplied source color in native ARGB32 layout
+typedef struct raster_color 
+{
+    unsigned int pixel;
+    int alpha, red, green, blue;
+} raster_color_t;
+
+static void rasterize( cairo_surface_t* surface, polygons_t* polygons, region_t* clip, int clear );
+static raster_row_t* get_raster_row( cairo_surface_t* surface, int width );
+static void free_raster_row( void* data );
+typedef int (*edge_table_kernel_t)( unsigned short* x, unsigned short* y, int origin_x, int origin_y, raster_edge_t* edges );
+
+static void rasterize_polygon( unsigned char* data, int stride, polygons_t* polygons, int index, int origin_x, int origin_y, region_t* clip, raster_row_t* row );
+static void add_span( raster_row_t* row, long long int from, long long int to, region_t* clip, int* x0, int* x1 );
+static void blend_row( unsigned int* pixels, raster_row_t* row, int x0, int x1, int clip_x1, raster_color_t* color );
+static void blend_span( unsigned int* pixels, int count, raster_color_t* color );
+static void blend_pixel( unsigned int* pixel, int coverage, raster_color_t* color );
+static int validate_rasterizer();
+
+static render_backend_t backends[] = {
+    { "cairo",    draw_polygons,      draw_polygons_clipped },
+    { "scanline", rasterize_polygons, rasterize_polygons_clipped }
+};
+
+static render_backend_t* render_backend = &backends[0];
+
+static cairo_user_data_key_t raster_row_key;
+
+static inline int div255( int value ) 
+{
+    value += 128;
+    return ( value + ( value >> 8 ) ) >> 8;
+}
+
+// Build the edge table sorted by the first sub-scanline every edge
+// crosses. Horizontal edges never cross a sub-scanline center. Returns
+// the number of edges.
+static inline int build_edge_table( unsigned short* x, unsigned short* y, int vertices, int origin_x, int origin_y, raster_edge_t* edges ) 
+{
+    int edge_count = 0;
+    int i, j;
+
+    for( i=0; i<vertices; ++i ) 
+    {
+        int previous = i == 0 ? vertices - 1 : i - 1;
+        vertex_t from, to;
+        vertex_t *upper, *lower;
+        raster_edge_t edge;
+
+        from.x = x[previous] + origin_x;
+        from.y = y[previous] + origin_y;
+        to.x   = x[i] + origin_x;
+        to.y   = y[i] + origin_y;
+
+        if ( from.y == to.y ) 
+        {
+            continue;
+        }
+        if ( from.y < to.y ) 
+        {
+            upper = &from;
+            lower = &to;
+            edge.direction = 1;
+        }
+        else 
+        {
+            upper = &to;
+            lower = &from;
+            edge.direction = -1;
+        }
+
+        // Sub-scanlines are sampled at their centers
+        edge.top    = upper->y * RASTER_SUBSAMPLES;
+        edge.bottom = lower->y * RASTER_SUBSAMPLES;
+        edge.dx     = ( (long long int)( lower->x - upper->x ) << 16 ) / ( edge.bottom - edge.top );
+        edge.x      = ( (long long int)( upper->x ) << 16 ) + edge.dx / 2;
+
+        for( j=edge_count; j>0 && edges[j - 1].top > edge.top; --j ) 
+        {
+            edges[j] = edges[j - 1];
+        }
+        edges[j] = edge;
+        ++edge_count;
+    }
+
+    return edge_count;
+}
+
+// One edge table builder for every vertex count, with the vertex loop
+// fully known to the compiler
+#define DEFINE_EDGE_TABLE( n ) \
+static int build_edge_table_##n( unsigned short* x, unsigned short* y, int origin_x, int origin_y, raster_edge_t* edges ) \
+{ \
+    return build_edge_table( x, y, n, origin_x, origin_y, edges ); \
+}
+#define EDGE_TABLE_ENTRY( n ) [n] = build_edge_table_##n,
+
+POLYGON_SPECIALIZE( DEFINE_EDGE_TABLE )
+
+static edge_table_kernel_t edge_table_kernels[POLYGON_MAX_VERTICES + 1] = {
+    POLYGON_SPECIALIZE( EDGE_TABLE_ENTRY )
+};
+
+const char* select_render_backend( const char* name ) 
+{
+    int i;
+    int count = sizeof( backends ) / sizeof( backends[0] );
+
+    if ( name == NULL ) 
+    {
+        render_backend = &backends[0];
+        return render_backend->name;
+    }
+
+    for( i=0; i<count; ++i ) 
+    {
+        if ( strcmp( name, backends[i].name ) == 0 ) 
+        {
+            render_backend = &backends[i];
+            if ( render_backend->draw == rasterize_polygons && !validate_rasterizer() ) 
+            {
+                printf( "The scanline rasterizer does not match the cairo output.\n" );
+                exit( EXIT_FAILURE );
+            }
+            return render_backend->name;
+        }
+    }
+
+    printf( "Unknown render backend %s.\n", name );
+    exit( EXIT_FAILURE );
+}
+
+void render_polygons( cairo_surface_t* surface, polygons_t* polygons ) 
+{
+    render_backend->draw( surface, polygons );
+}
+
+void render_polygons_clipped( cairo_surface_t* surface, polygons_t* polygons, region_t* region ) 
+{
+    render_backend->draw_clipped( surface, polygons, region );
+}
+
+void rasterize_polygons( cairo_surface_t* surface, polygons_t* polygons ) 
+{
+    // Everything is clipped to the surface extents anyway
+    region_t full;
+    full.x0 = INT_MIN / 2;
+    full.y0 = INT_MIN / 2;
+    full.x1 = INT_MAX / 2;
+    full.y1 = INT_MAX / 2;
+    rasterize( surface, polygons, &full, 0 );
+}
+
+void rasterize_polygons_clipped( cairo_surface_t* surface, polygons_t* polygons, region_t* region ) 
+{
+    rasterize( surface, polygons, region, 1 );
+}
+
+static void rasterize( cairo_surface_t* surface, polygons_t* polygons, region_t* region, int clear ) 
+{
+    int i, y;
+    int width  = cairo_image_surface_get_width( surface );
+    int height = cairo_image_surface_get_height( surface );
+    int stride = cairo_image_surface_get_stride( surface );
+    double offset_x, offset_y;
+    int origin_x, origin_y;
+    unsigned char* data;
+    region_t device;
+    region_t* clip = &device;
+    raster_row_t* row;
+
+    // Surfaces may show a part of a larger canvas using a device offset.
+    // All rasterization happens in device space, clipped to the surface.
+    cairo_surface_get_device_offset( surface, &offset_x, &offset_y );
+    origin_x  = (int)offset_x;
+    origin_y  = (int)offset_y;
+    device.x0 = region->x0 + origin_x < 0 ? 0 : region->x0 + origin_x;
+    device.y0 = region->y0 + origin_y < 0 ? 0 : region->y0 + origin_y;
+    device.x1 = region->x1 + origin_x > width ? width : region->x1 + origin_x;
+    device.y1 = region->y1 + origin_y > height ? height : region->y1 + origin_y;
+
+    if ( clip->x0 >= clip->x1 || clip->y0 >= clip->y1 ) 
+    {
+        return;
+    }
+
+    cairo_surface_flush( surface );
+    data = cairo_image_surface_get_data( surface );
+    if ( data == NULL ) 
+    {
+        printf( "Could not access render surface data during rasterization\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    if ( clear ) 
+    {
+        for( y=clip->y0; y<clip->y1; ++y ) 
+        {
+            memset( data + y * stride + clip->x0 * 4, 0, ( clip->x1 - clip->x0 ) * 4 );
+        }
+    }
+
+    row = get_raster_row( surface, width );
+    for( i=0; i<polygons->count; ++i ) 
+    {
+        rasterize_polygon( data, stride, polygons, i, origin_x, origin_y, clip, row );
+    }
+
+    cairo_surface_mark_dirty_rectangle( surface, 
+        clip->x0, 
+        clip->y0, 
+        clip->x1 - clip->x0, 
+        clip->y1 - clip->y0 
+    );
+}
+
+static raster_row_t* get_raster_row( cairo_surface_t* surface, int width ) 
+{
+    raster_row_t* row = cairo_surface_get_user_data( surface, &raster_row_key );
+
+    if ( row != NULL ) 
+    {
+        return row;
+    }
+
+    // One spare entry on each side, as spans ending exactly on the clip
+    // border place their end marker one pixel behind it
+    row = malloc( sizeof( raster_row_t ) * sizeof( char ) );
+    row->cover = calloc( ( width + 2 ) * 2, sizeof( int ) );
+    row->delta = row->cover + width + 2;
+
+    if ( cairo_surface_set_user_data( surface, &raster_row_key, row, free_raster_row ) != CAIRO_STATUS_SUCCESS ) 
+    {
+        printf( "Could not attach the rasterization buffers to the render surface\n" );
+        exit( EXIT_FAILURE );
+    }
+    return row;
+}
+
+static void free_raster_row( void* data ) 
+{
+    raster_row_t* row = data;
+    free( row->cover );
+    free( row );
+}
+
+static void rasterize_polygon( unsigned char* data, int stride, polygons_t* polygons, int index, int origin_x, int origin_y, region_t* clip, raster_row_t* row ) 
+{
+    raster_edge_t edges[POLYGON_MAX_VERTICES];
+    raster_edge_t* active[POLYGON_MAX_VERTICES];
+    int edge_count, active_count = 0, next_edge = 0;
+    int i, j, y, s;
+    int first_row, last_row;
+    raster_color_t color;
+
+    edge_count = edge_table_kernels[polygons->vertices[index]]( 
+        polygons->x + index * polygons->max_vertices, 
+        polygons->y + index * polygons->max_vertices, 
+        origin_x, 
+        origin_y, 
+        edges 
+    );
+
+    if ( edge_count == 0 ) 
+    {
+        return;
+    }
+
+    first_row = edges[0].top / RASTER_SUBSAMPLES;
+    last_row  = 0;
+    for( i=0; i<edge_count; ++i ) 
+    {
+        if ( edges[i].bottom / RASTER_SUBSAMPLES > last_row ) 
+        {
+            last_row = edges[i].bottom / RASTER_SUBSAMPLES;
+        }
+    }
+    first_row = first_row < clip->y0 ? clip->y0 : first_row;
+    last_row  = last_row > clip->y1 ? clip->y1 : last_row;
+
+    color.alpha = POLYGON_COLOR( polygons, index, 3 );
+    color.red   = div255( POLYGON_COLOR( polygons, index, 0 ) * color.alpha );
+    color.green = div255( POLYGON_COLOR( polygons, index, 1 ) * color.alpha );
+    color.blue  = div255( POLYGON_COLOR( polygons, index, 2 ) * color.alpha );
+    color.pixel = ( (unsigned int)color.alpha << 24 ) | ( color.red << 16 ) | ( color.green << 8 ) | color.blue;
+
+    for( y=first_row; y<last_row; ++y ) 
+    {
+        int x0 = clip->x1, x1 = clip->x0;
+
+        for( s=y * RASTER_SUBSAMPLES; s<( y + 1 ) * RASTER_SUBSAMPLES; ++s ) 
+        {
+            int winding = 0;
+            long long int span_start = 0;
+
+            // Move newly reached edges to the active list. If rendering
+            // starts below an edge's top, its position is advanced first.
+            while( next_edge < edge_count && edges[next_edge].top <= s ) 
+            {
+                raster_edge_t* edge = &edges[next_edge++];
+                if ( edge->bottom > s ) 
+                {
+                    edge->x += edge->dx * ( s - edge->top );
+                    active[active_count++] = edge;
+                }
+            }
+
+            // Drop the edges which ended above this sub-scanline and keep
+            // the remaining ones ordered by their position
+            for( i=0; i<active_count; ) 
+            {
+                if ( active[i]->bottom <= s ) 
+                {
+                    active[i] = active[--active_count];
+                }
+                else 
+                {
+                    ++i;
+                }
+            }
+            for( i=1; i<active_count; ++i ) 
+            {
+                raster_edge_t* edge = active[i];
+                for( j=i; j>0 && active[j - 1]->x > edge->x; --j ) 
+                {
+                    active[j] = active[j - 1];
+                }
+                active[j] = edge;
+            }
+
+            // Emit spans using the nonzero winding rule, like cairo_fill
+            for( i=0; i<active_count; ++i ) 
+            {
+                int previous = winding;
+                winding += active[i]->direction;
+                if ( previous == 0 && winding != 0 ) 
+                {
+                    span_start = active[i]->x;
+                }
+                else if ( previous != 0 && winding == 0 ) 
+                {
+                    add_span( row, span_start, active[i]->x, clip, &x0, &x1 );
+                }
+                active[i]->x += active[i]->dx;
+            }
+        }
+
+        if ( x0 < x1 ) 
+        {
+            blend_row( (unsigned int*)( data + y * stride ), row, x0, x1, clip->x1, &color );
+        }
+    }
+}
+
+static void add_span( raster_row_t* row, long long int from, long long int to, region_t* clip, int* x0, int* x1 ) 
+{
+    // Convert from 16.16 fixed point to sub-pixel units
+    long long int a = ( from * RASTER_SUBSAMPLES + 32768 ) >> 16;
+    long long int b = ( to * RASTER_SUBSAMPLES + 32768 ) >> 16;
+    int first, last;
+
+    a = a < clip->x0 * RASTER_SUBSAMPLES ? clip->x0 * RASTER_SUBSAMPLES : a;
+    b = b > clip->x1 * RASTER_SUBSAMPLES ? clip->x1 * RASTER_SUBSAMPLES : b;
+    if ( a >= b ) 
+    {
+        return;
+    }
+
+    first = (int)( a / RASTER_SUBSAMPLES );
+    last  = (int)( b / RASTER_SUBSAMPLES );
+    if ( first == last ) 
+    {
+        row->cover[first] += (int)( b - a );
+    }
+    else 
+    {
+        row->cover[first]     += RASTER_SUBSAMPLES - (int)( a % RASTER_SUBSAMPLES );
+        row->delta[first + 1] += RASTER_SUBSAMPLES;
+        row->delta[last]      -= RASTER_SUBSAMPLES;
+        row->cover[last]      += (int)( b % RASTER_SUBSAMPLES );
+    }
+
+    *x0 = first < *x0 ? first : *x0;
+    *x1 = last + 1 > *x1 ? last + 1 : *x1;
+}
+
+static void blend_row( unsigned int* pixels, raster_row_t* row, int x0, int x1, int clip_x1, raster_color_t* color ) 
+{
+    int x, end;
+    int running = 0;
+
+    // Resolve the run markers into per pixel coverage
+    for( x=x0; x<x1; ++x ) 
+    {
+        running += row->delta[x];
+        row->delta[x] = 0;
+        row->cover[x] += running;
+    }
+
+    end = x1 > clip_x1 ? clip_x1 : x1;
+    x = x0;
+    while( x < end ) 
+    {
+        if ( row->cover[x] >= RASTER_FULL_COVERAGE ) 
+        {
+            int start = x;
+            while( x < end && row->cover[x] >= RASTER_FULL_COVERAGE ) 
+            {
+                row->cover[x++] = 0;
+            }
+            blend_span( pixels + start, x - start, color );
+        }
+        else 
+        {
+            if ( row->cover[x] > 0 ) 
+            {
+                blend_pixel( pixels + x, row->cover[x], color );
+            }
+            row->cover[x++] = 0;
+        }
+    }
+    for( ; x<x1; ++x ) 
+    {
+        row->cover[x] = 0;
+    }
+}
+
+static void blend_span( unsigned int* pixels, int count, raster_color_t* color ) 
+{
+    int i = 0;
+
+#ifdef __SSE2__
+    // Four pixels at once: dst = src + dst * ( 255 - alpha ) / 255
+    __m128i zero    = _mm_setzero_si128();
+    __m128i inverse = _mm_set1_epi16( (short)( 255 - color->alpha ) );
+    __m128i bias    = _mm_set1_epi16( 128 );
+    __m128i source  = _mm_set1_epi32( (int)color->pixel );
+
+    for( ; i + 4 <= count; i += 4 ) 
+    {
+        __m128i destination = _mm_loadu_si128( (__m128i*)( pixels + i ) );
+        __m128i low  = _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( destination, zero ), inverse ), bias );
+        __m128i high = _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( destination, zero ), inverse ), bias );
+        low  = _mm_srli_epi16( _mm_add_epi16( low, _mm_srli_epi16( low, 8 ) ), 8 );
+        high = _mm_srli_epi16( _mm_add_epi16( high, _mm_srli_epi16( high, 8 ) ), 8 );
+        _mm_storeu_si128( (__m128i*)( pixels + i ), _mm_add_epi8( _mm_packus_epi16( low, high ), source ) );
+    }
+#endif
+
+    for( ; i<count; ++i ) 
+    {
+        blend_pixel( pixels + i, RASTER_FULL_COVERAGE, color );
+    }
+}
+
+static void blend_pixel( unsigned int* pixel, int coverage, raster_color_t* color ) 
+{
+    unsigned int destination = *pixel;
+    int alpha = color->alpha, red = color->red, green = color->green, blue = color->blue;
+    int inverse;
+
+    if ( coverage < RASTER_FULL_COVERAGE ) 
+    {
+        alpha = ( alpha * coverage + RASTER_FULL_COVERAGE / 2 ) / RASTER_FULL_COVERAGE;
+        red   = ( red * coverage + RASTER_FULL_COVERAGE / 2 ) / RASTER_FULL_COVERAGE;
+        green = ( green * coverage + RASTER_FULL_COVERAGE / 2 ) / RASTER_FULL_COVERAGE;
+        blue  = ( blue * coverage + RASTER_FULL_COVERAGE / 2 ) / RASTER_FULL_COVERAGE;
+    }
+    inverse = 255 - alpha;
+
+    *pixel = ( (unsigned int)( alpha + div255( ( destination >> 24 ) * inverse ) ) << 24 )
+           | ( (unsigned int)( red + div255( ( ( destination >> 16 ) & 0xff ) * inverse ) ) << 16 )
+           | ( (unsigned int)( green + div255( ( ( destination >> 8 ) & 0xff ) * inverse ) ) << 8 )
+           | (unsigned int)( blue + div255( ( destination & 0xff ) * inverse ) );
+}
+
+static int validate_rasterizer() 
+{
+    // Render a fixed pseudo random set of polygons with cairo and the
+    // scanline rasterizer and compare the results. The generator is local,
+    // so the validation does not disturb the seeded random sequence.
+    unsigned int state = 1;
+    int i, j, size;
+    int maximum = 0;
+    unsigned long long int total = 0;
+    unsigned char *reference_data, *scanline_data;
+    polygons_t* polygons;
+    cairo_surface_t* reference = cairo_image_surface_create( CAIRO_FORMAT_ARGB32, RASTER_VALIDATION_WIDTH, RASTER_VALIDATION_HEIGHT );
+    cairo_surface_t* scanline  = cairo_image_surface_create( CAIRO_FORMAT_ARGB32, RASTER_VALIDATION_WIDTH, RASTER_VALIDATION_HEIGHT );
+
+    polygons = malloc( sizeof( polygons_t ) * sizeof( char ) );
+    map_polygons( polygons, malloc( POLYGON_GENOME_SIZE( POLYGON_MAX_VERTICES ) * sizeof( char ) * RASTER_VALIDATION_POLYGONS ), RASTER_VALIDATION_POLYGONS, POLYGON_MAX_VERTICES );
+    polygons->min_vertices = POLYGON_MIN_VERTICES;
+    polygons->original_width  = RASTER_VALIDATION_WIDTH;
+    polygons->original_height = RASTER_VALIDATION_HEIGHT;
+
+    // Every supported vertex count is covered
+    for( i=0; i<polygons->count; ++i ) 
+    {
+        polygons->vertices[i] = POLYGON_MIN_VERTICES + i % ( POLYGON_MAX_VERTICES - POLYGON_MIN_VERTICES + 1 );
+        for( j=0; j<polygons->vertices[i]; ++j ) 
+        {
+            state = state * 1103515245 + 12345;
+            POLYGON_X( polygons, i, j ) = ( state >> 8 ) % ( RASTER_VALIDATION_WIDTH + 1 );
+            state = state * 1103515245 + 12345;
+            POLYGON_Y( polygons, i, j ) = ( state >> 8 ) % ( RASTER_VALIDATION_HEIGHT + 1 );
+        }
+        for( j=0; j<4; ++j ) 
+        {
+            state = state * 1103515245 + 12345;
+            POLYGON_COLOR( polygons, i, j ) = ( state >> 8 ) % 256;
+        }
+    }
+
+    draw_polygons( reference, polygons );
+    rasterize_polygons( scanline, polygons );
+
+    cairo_surface_flush( reference );
+    reference_data = cairo_image_surface_get_data( reference );
+    scanline_data  = cairo_image_surface_get_data( scanline );
+    size = cairo_image_surface_get_stride( reference ) * RASTER_VALIDATION_HEIGHT;
+    for( i=0; i<size; ++i ) 
+    {
+        int difference = abs( reference_data[i] - scanline_data[i] );
+        maximum = difference > maximum ? difference : maximum;
+        total  += difference;
+    }
+
+    free_polygons( polygons );
+    cairo_surface_destroy( reference );
+    cairo_surface_destroy( scanline );
+
+    return (double)total / size <= RASTER_TOLERANCE_MEAN && maximum <= RASTER_TOLERANCE_MAX;
+}
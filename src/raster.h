@@ -0,0 +1,42 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef RASTER_H
+#define RASTER_H
+
+// Number of sub-scanlines sampled per pixel row. The horizontal coverage is
+// tracked with the same precision, so a fully covered pixel accumulates
+// RASTER_SUBSAMPLES^2 coverage units.
+#define RASTER_SUBSAMPLES 16
+#define RASTER_FULL_COVERAGE ( RASTER_SUBSAMPLES * RASTER_SUBSAMPLES )
+
+// Maximal mean and maximal absolute byte difference between the scanline
+// and the cairo rendering, which is tolerated on backend selection.
+#define RASTER_TOLERANCE_MEAN 1.0
+#define RASTER_TOLERANCE_MAX  48
+
+const char* select_render_backend( const char* name );
+
+void render_polygons( cairo_surface_t* surface, polygons_t* polygons );
+void render_polygons_clipped( cairo_surface_t* surface, polygons_t* polygons, region_t* region );
+
+void rasterize_polygons( cairo_surface_t* surface, polygons_t* polygons );
+void rasterize_polygons_clipped( cairo_surface_t* surface, polygons_t* polygons, region_t* region );
+
+#endif
@@ -0,0 +1,178 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <cairo.h>
+
+#include "random.h"
+#include "polygon.h"
+#include "raster.h"
+#include "spatial.h"
+#include "incremental.h"
+#include "bands.h"
+#include "layers.h"
+#include "screen.h"
+#include "chain.h"
+#include "snapshot.h"
+#include "journal.h"
+
+static void show_usage();
+
+int main( int argc, char** argv ) 
+{
+    journal_reader_t* reader;
+
+    // Canvas of the input image and the surface the states are rendered to
+    cairo_surface_t* canvas;
+    cairo_surface_t* render_surface = NULL;
+
+    // Iteration to render the state of (the final state if not given)
+    unsigned int target = 0;
+    int targeted        = 0;
+
+    // Iterations between two frames (0 to render a single state)
+    unsigned int frame_iterations = 0;
+
+    // Write svg files in addition to the pngs
+    int svg = 0;
+
+    // Polygon rendering backend (NULL for cairo)
+    char* backend_name = NULL;
+
+    unsigned int iteration = 0;
+    unsigned int next;
+    char name[32];
+
+    char* journal_file;
+    char* output_directory;
+
+    // Read commandline arguments
+    {
+        extern char *optarg;
+        extern int optind, optopt;
+        int c;
+        while( ( c = getopt( argc, argv, "i:f:sr:" ) ) != -1 ) 
+        {
+            switch( c ) 
+            {
+                case '?':
+                    show_usage();
+                    exit( EXIT_FAILURE );
+                break;
+                case 'i':
+                    target   = strtoul( optarg, NULL, 10 );
+                    targeted = 1;
+                break;
+                case 'f':
+                    frame_iterations = strtoul( optarg, NULL, 10 );
+                break;
+                case 's':
+                    svg = 1;
+                break;
+                case 'r':
+                    backend_name = optarg;
+                break;
+            }
+        }
+
+        if ( argc - optind < 2 ) 
+        {
+            show_usage();
+            exit( EXIT_FAILURE );
+        }
+    }
+
+    journal_file     = argv[optind];
+    output_directory = argv[argc - 1];
+
+    printf( "Render backend: %s\n", select_render_backend( backend_name ) );
+
+    reader = read_journal( journal_file );
+    canvas = cairo_image_surface_create( CAIRO_FORMAT_ARGB32, reader->header.width, reader->header.height );
+    peek_journal( reader, &next );
+    printf( "Journal: %d records, iterations %u to %u\n", reader->count, next, reader->iterations[reader->count - 1] );
+
+    if ( frame_iterations > 0 ) 
+    {
+        // Every frame shows the state after all records up to its
+        // iteration. It is complete as soon as the next record is later.
+        unsigned int frame = 0;
+        unsigned int frame_iteration = next;
+
+        while( peek_journal( reader, &next ) ) 
+        {
+            for( ; frame_iteration < next; frame_iteration += frame_iterations ) 
+            {
+                sprintf( name, "frame%06u", frame++ );
+                write_snapshot( canvas, &render_surface, reader->polygons, output_directory, name, 1, svg );
+            }
+            replay_journal( reader, &iteration );
+        }
+        if ( frame_iteration <= iteration ) 
+        {
+            sprintf( name, "frame%06u", frame++ );
+            write_snapshot( canvas, &render_surface, reader->polygons, output_directory, name, 1, svg );
+        }
+    }
+    else if ( targeted ) 
+    {
+        if ( target < next ) 
+        {
+            printf( "The journal starts at iteration %u.\n", next );
+            exit( EXIT_FAILURE );
+        }
+        while( peek_journal( reader, &next ) && next <= target ) 
+        {
+            replay_journal( reader, &iteration );
+        }
+        sprintf( name, "%010u", target );
+        write_snapshot( canvas, &render_surface, reader->polygons, output_directory, name, 1, svg );
+    }
+    else 
+    {
+        while( replay_journal( reader, &iteration ) );
+        write_snapshot( canvas, &render_surface, reader->polygons, output_directory, "final", 1, svg );
+    }
+
+    if ( render_surface != NULL ) 
+    {
+        cairo_surface_destroy( render_surface );
+    }
+    cairo_surface_destroy( canvas );
+    free_journal_reader( reader );
+    return 0;
+}
+
+static void show_usage() 
+{
+    printf( "Evolving Vectorizer journal replay\n" );
+    printf( "Usage:\n" );
+    printf( "   replay [options] <journal> <outputdirectory>\n" );
+    printf( "Options:\n" );
+    printf( "   -i <int>:   Render the state at iteration <int> as\n\
+               <iteration>.png (Default: the final state as\n\
+               final.png)\n" );
+    printf( "   -f <int>:   Render the state every <int> iterations as\n\
+               frame<number>.png, for example to encode a video\n" );
+    printf( "   -s:         Write svg files as well\n" );
+    printf( "   -r <name>:  Render backend to use (cairo or scanline)\n\
+               (Default: cairo) SVG files are always drawn by cairo\n" );
+}
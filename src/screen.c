@@ -0,0 +1,142 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <cairo.h>
+
+#include "polygon.h"
+#include "fitness.h"
+#include "screen.h"
+
+screen_t* initialize_screen( cairo_surface_t* original, cairo_surface_t* render_surface, int stride ) 
+{
+    screen_t* screen = malloc( sizeof( screen_t ) * sizeof( char ) );
+
+    screen->height         = cairo_image_surface_get_height( original );
+    screen->stride         = stride;
+    screen->phase          = 0;
+    screen->rows           = malloc( sizeof( unsigned long long int ) * screen->height );
+    screen->candidate_rows = malloc( sizeof( unsigned long long int ) * screen->height );
+
+    screen->screened  = 0;
+    screen->rejected  = 0;
+    screen->passed    = 0;
+    screen->overruled = 0;
+    screen->audited   = 0;
+    screen->disagreed = 0;
+
+    // The render surface holds the accepted state
+    quadratic_error_rows( original, render_surface, screen->rows, 0, 1 );
+
+    return screen;
+}
+
+unsigned long long int evaluate_screen( screen_t* screen, cairo_surface_t* original, cairo_surface_t* render_surface, unsigned long long int current_fitness, unsigned long long int limit ) 
+{
+    unsigned long long int fitness = 0;
+    long long int change = 0;
+    int phase = screen->phase;
+    int audit = 0;
+    int y, offset;
+
+    screen->phase = ( screen->phase + 1 ) % screen->stride;
+    ++screen->screened;
+
+    // Change of the sampled rows against the accepted state
+    quadratic_error_rows( original, render_surface, screen->candidate_rows, phase, screen->stride );
+    for( y=phase; y<screen->height; y+=screen->stride ) 
+    {
+        change += (long long int)screen->candidate_rows[y] - (long long int)screen->rows[y];
+    }
+
+    if ( limit != ULLONG_MAX && change > 0 && (double)change * screen->stride > SCREEN_MARGIN * ( limit - current_fitness ) ) 
+    {
+        ++screen->rejected;
+        audit = screen->rejected % SCREEN_AUDIT_INTERVAL == 0;
+        if ( !audit ) 
+        {
+            // Like a bounded evaluation stopped at the limit, anything above
+            // it is rejected
+            return limit + 1;
+        }
+    }
+    else 
+    {
+        ++screen->passed;
+    }
+
+    // Score the remaining rows
+    for( offset=0; offset<screen->stride; ++offset ) 
+    {
+        if ( offset != phase ) 
+        {
+            quadratic_error_rows( original, render_surface, screen->candidate_rows, offset, screen->stride );
+        }
+    }
+    for( y=0; y<screen->height; ++y ) 
+    {
+        fitness += screen->candidate_rows[y];
+    }
+
+    // Audited candidates are decided on their exact error as well
+    if ( audit ) 
+    {
+        ++screen->audited;
+        if ( fitness <= limit ) 
+        {
+            ++screen->disagreed;
+        }
+    }
+    else if ( fitness > limit ) 
+    {
+        ++screen->overruled;
+    }
+    return fitness;
+}
+
+void accept_screen( screen_t* screen ) 
+{
+    // Only completely scored candidates can be accepted
+    unsigned long long int* rows = screen->rows;
+    screen->rows           = screen->candidate_rows;
+    screen->candidate_rows = rows;
+}
+
+void print_screen_statistics( screen_t* screen ) 
+{
+    if ( screen->screened == 0 ) 
+    {
+        return;
+    }
+    printf( "Screening: %.2f%% of the candidates rejected on %d%% of the rows, %.2f%% of the passed ones rejected on the exact error, %llu of %llu audited rejections disagreed with the exact error\n", 
+        100.0 * screen->rejected / screen->screened,
+        100 / screen->stride,
+        screen->passed > 0 ? 100.0 * screen->overruled / screen->passed : 0.0,
+        screen->disagreed,
+        screen->audited
+    );
+}
+
+void free_screen( screen_t* screen ) 
+{
+    free( screen->rows );
+    free( screen->candidate_rows );
+    free( screen );
+}
@@ -0,0 +1,65 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#define SCREEN_DEFAULT_STRIDE 4
+
+// A candidate is rejected on the estimate alone if its estimated error
+// increase exceeds the one the acceptance test allows this many times
+#define SCREEN_MARGIN 2.0
+
+// Every this many rejections on the estimate the exact error is computed
+// as well, to count how often the screen disagrees with the exact test
+#define SCREEN_AUDIT_INTERVAL 64
+
+// Screening of full evaluations on a sample of rows. The error of every row
+// of the accepted state is cached. A candidate is scored on every stride-th
+// row first, starting at a row which rotates with every evaluation, and the
+// change against the cached rows is extrapolated to the whole image. Only
+// candidates which might pass the acceptance test are scored completely,
+// so the fitness of accepted states is always exact.
+typedef struct screen 
+{
+    int height;
+    int stride;
+    int phase;
+
+    unsigned long long int* rows;           // Of the accepted state
+    unsigned long long int* candidate_rows; // Of the last exact evaluation
+
+    unsigned long long int screened;
+    unsigned long long int rejected;  // On the estimate alone
+    unsigned long long int passed;    // Scored completely after the estimate
+    unsigned long long int overruled; // Passed, but rejected on the exact error
+    unsigned long long int audited;   // Rejections checked on the exact error
+    unsigned long long int disagreed; // Audited ones the exact test may accept
+} screen_t;
+
+screen_t* initialize_screen( cairo_surface_t* original, cairo_surface_t* render_surface, int stride );
+
+unsigned long long int evaluate_screen( screen_t* screen, cairo_surface_t* original, cairo_surface_t* render_surface, unsigned long long int current_fitness, unsigned long long int limit );
+void accept_screen( screen_t* screen );
+
+void print_screen_statistics( screen_t* screen );
+
+void free_screen( screen_t* screen );
+
+#endif
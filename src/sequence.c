@@ -0,0 +1,215 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <cairo.h>
+
+#include "random.h"
+#include "polygon.h"
+#include "spatial.h"
+#include "incremental.h"
+#include "bands.h"
+#include "layers.h"
+#include "screen.h"
+#include "chain.h"
+#include "snapshot.h"
+#include "image.h"
+#include "bench.h"
+#include "batch.h"
+#include "sequence.h"
+
+static polygons_t* anneal_frame( sequence_frame_t* frame, cairo_surface_t* original, polygons_t* polygons, double temperature, double alpha, batch_settings_t* settings, rand_state_t* random, char* output_directory, int index );
+static void write_sequence_summary( sequence_frame_t* frames, int count, char* filename );
+
+void run_sequence( char* source, char* output_directory, sequence_settings_t* sequence, rand_state_t* random ) 
+{
+    batch_settings_t* settings = sequence->settings;
+    sequence_frame_t* frames;
+    polygons_t* polygons = NULL;
+    char** inputs;
+    char* filename;
+    int i, count;
+    double cold_iterations, warm_temperature, warm_alpha;
+    unsigned int warm_iterations;
+
+    count = read_batch_inputs( source, &inputs );
+    if ( count == 0 ) 
+    {
+        printf( "No frames found in %s.\n", source );
+        exit( EXIT_FAILURE );
+    }
+    if ( !make_directory( output_directory ) ) 
+    {
+        printf( "Could not create output directory %s.\n", output_directory );
+        exit( EXIT_FAILURE );
+    }
+
+    // The warm schedule covers the range from the warm temperature down to
+    // epsilon in the given number of iterations
+    cold_iterations  = log( settings->epsilon / settings->temperature ) / log( settings->alpha );
+    warm_temperature = sequence->warm_temperature > 0 ? sequence->warm_temperature : settings->temperature * SEQUENCE_DEFAULT_WARM_RATIO;
+    warm_iterations  = sequence->warm_iterations > 0 ? sequence->warm_iterations : (unsigned int)( cold_iterations / SEQUENCE_DEFAULT_WARM_SPEEDUP );
+    if ( warm_temperature <= settings->epsilon || warm_iterations == 0 ) 
+    {
+        printf( "The warm start temperature has to be above epsilon.\n" );
+        exit( EXIT_FAILURE );
+    }
+    warm_alpha = pow( settings->epsilon / warm_temperature, 1.0 / warm_iterations );
+    printf( "Sequence: %d frames, warm start at %f for %u iterations\n", count, warm_temperature, warm_iterations );
+
+    frames = calloc( count, sizeof( sequence_frame_t ) );
+    for( i=0; i<count; ++i ) 
+    {
+        cairo_surface_t* original;
+
+        frames[i].input_file = inputs[i];
+        if ( ( original = load_image_surface( inputs[i] ) ) == NULL ) 
+        {
+            printf( "Could not load frame %s.\n", inputs[i] );
+            exit( EXIT_FAILURE );
+        }
+
+        if ( polygons == NULL ) 
+        {
+            // Only the first frame is a cold start
+            polygons = initialize_polygons( original, settings->polygon_count, settings->min_vertices, settings->max_vertices, random );
+            polygons = anneal_frame( &frames[i], original, polygons, settings->temperature, settings->alpha, settings, random, output_directory, i );
+        }
+        else 
+        {
+            // Frames of a different size continue from the scaled genome
+            if ( polygons->original_width != cairo_image_surface_get_width( original ) 
+              || polygons->original_height != cairo_image_surface_get_height( original ) ) 
+            {
+                scale_polygons( polygons, cairo_image_surface_get_width( original ), cairo_image_surface_get_height( original ) );
+            }
+            polygons = anneal_frame( &frames[i], original, polygons, warm_temperature, warm_alpha, settings, random, output_directory, i );
+        }
+
+        printf( "Frame %d/%d %s: %u iterations in %.1fs (%llu to %llu)\n", 
+            i + 1, 
+            count, 
+            frames[i].input_file, 
+            frames[i].iterations, 
+            frames[i].seconds, 
+            frames[i].start_fitness, 
+            frames[i].best_fitness 
+        );
+        cairo_surface_destroy( original );
+    }
+    free_polygons( polygons );
+    free( inputs );
+
+    filename = malloc( sizeof( char ) * ( strlen( output_directory ) + strlen( SEQUENCE_SUMMARY_FILENAME ) + 2 ) );
+    sprintf( filename, "%s/%s", output_directory, SEQUENCE_SUMMARY_FILENAME );
+    write_sequence_summary( frames, count, filename );
+    printf( "Sequence: %s written.\n", filename );
+    free( filename );
+
+    for( i=0; i<count; ++i ) 
+    {
+        free( frames[i].input_file );
+    }
+    free( frames );
+}
+
+static polygons_t* anneal_frame( sequence_frame_t* frame, cairo_surface_t* original, polygons_t* polygons, double temperature, double alpha, batch_settings_t* settings, rand_state_t* random, char* output_directory, int index ) 
+{
+    cairo_surface_t* render_surface = NULL;
+    chain_t* chain;
+    struct timespec start, end;
+    unsigned int iteration = 0;
+    char name[16];
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+
+    frame->width  = cairo_image_surface_get_width( original );
+    frame->height = cairo_image_surface_get_height( original );
+
+    // The chain takes over the polygons
+    chain = initialize_chain( original, polygons, temperature, random, &settings->options );
+    frame->start_fitness = chain->exact_current_fitness;
+
+    while( 1 ) 
+    {
+        step_chain( chain );
+
+        if( chain->temperature < settings->epsilon ) 
+        {
+            break;
+        }
+        chain->temperature *= alpha;
+        ++iteration;
+    }
+
+    // Every frame is written, so the snapshots are not queued on the
+    // coalescing background writer
+    sprintf( name, "frame%06d", index );
+    write_snapshot( original, &render_surface, update_chain_best( chain ), output_directory, name, 1, 1 );
+    measure_chain( chain );
+
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    frame->iterations   = iteration;
+    frame->best_fitness = chain->exact_best_fitness;
+    frame->seconds      = (double)( end.tv_sec - start.tv_sec ) + (double)( end.tv_nsec - start.tv_nsec ) / 1e9;
+
+    // The best polygons of this frame seed the next one
+    polygons = copy_polygons( update_chain_best( chain ) );
+    free_chain( chain );
+    if ( render_surface != NULL ) 
+    {
+        cairo_surface_destroy( render_surface );
+    }
+    return polygons;
+}
+
+static void write_sequence_summary( sequence_frame_t* frames, int count, char* filename ) 
+{
+    FILE* file;
+    int i;
+
+    if ( ( file = fopen( filename, "w" ) ) == NULL ) 
+    {
+        printf( "Could not open sequence summary %s.\n", filename );
+        exit( EXIT_FAILURE );
+    }
+
+    fprintf( file, "[\n" );
+    for( i=0; i<count; ++i ) 
+    {
+        fprintf( file, "    {\"frame\": %d, \"input\": ", i );
+        write_json_string( file, frames[i].input_file );
+        fprintf( file, ", \"width\": %d, \"height\": %d, \"iterations\": %u, \"seconds\": %.3f, \"start_fitness\": %llu, \"best_fitness\": %llu}%s\n",
+            frames[i].width,
+            frames[i].height,
+            frames[i].iterations,
+            frames[i].seconds,
+            frames[i].start_fitness,
+            frames[i].best_fitness,
+            i < count - 1 ? "," : ""
+        );
+    }
+    fprintf( file, "]\n" );
+    fclose( file );
+}
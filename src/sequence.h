@@ -0,0 +1,52 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#define SEQUENCE_SUMMARY_FILENAME "sequence.json"
+
+// Warm started frames begin at this fraction of the initial temperature and
+// run this many times fewer iterations than a cold start, unless given
+#define SEQUENCE_DEFAULT_WARM_RATIO   0.01
+#define SEQUENCE_DEFAULT_WARM_SPEEDUP 10
+
+// Settings of a frame sequence. The first frame is annealed with the batch
+// settings, every further one starts from the best polygons of the frame
+// before it with the shorter warm schedule.
+typedef struct sequence_settings 
+{
+    batch_settings_t* settings;
+    double warm_temperature;      // 0 for the default ratio
+    unsigned int warm_iterations; // 0 for the default speedup
+} sequence_settings_t;
+
+typedef struct sequence_frame 
+{
+    char* input_file;
+    int width, height;
+    unsigned int iterations;
+    unsigned long long int start_fitness;
+    unsigned long long int best_fitness;
+    double seconds;
+} sequence_frame_t;
+
+void run_sequence( char* source, char* output_directory, sequence_settings_t* sequence, rand_state_t* random );
+
+#endif
@@ -0,0 +1,221 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <cairo.h>
+
+#include "polygon.h"
+#include "raster.h"
+#include "spatial.h"
+#include "incremental.h"
+#include "bands.h"
+#include "layers.h"
+#include "screen.h"
+#include "chain.h"
+#include "snapshot.h"
+
+static void* run_snapshot_writer( void* data );
+
+snapshot_writer_t* initialize_snapshot_writer( cairo_surface_t* input, char* output_directory ) 
+{
+    int i;
+    snapshot_writer_t* writer = malloc( sizeof( snapshot_writer_t ) * sizeof( char ) );
+
+    writer->input            = input;
+    writer->render_surface   = NULL;
+    writer->output_directory = output_directory;
+    writer->head             = 0;
+    writer->length           = 0;
+    writer->working          = NULL;
+    writer->running          = 1;
+    writer->written          = 0;
+    writer->coalesced        = 0;
+
+    // The polygon copies are allocated on first use and recycled afterwards
+    for( i=0; i<SNAPSHOT_QUEUE_SIZE; ++i ) 
+    {
+        writer->queue[i].polygons = NULL;
+    }
+
+    pthread_mutex_init( &writer->lock, NULL );
+    pthread_cond_init( &writer->wakeup, NULL );
+
+    if ( pthread_create( &writer->thread, NULL, run_snapshot_writer, writer ) != 0 ) 
+    {
+        printf( "Could not create snapshot writer thread.\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    return writer;
+}
+
+void queue_snapshot( snapshot_writer_t* writer, polygons_t* polygons, char* name, int png, int svg ) 
+{
+    snapshot_request_t* request;
+
+    pthread_mutex_lock( &writer->lock );
+
+    if ( writer->length == SNAPSHOT_QUEUE_SIZE ) 
+    {
+        // The writer fell behind. Coalesce with the newest pending request.
+        request = &writer->queue[( writer->head + writer->length - 1 ) % SNAPSHOT_QUEUE_SIZE];
+        request->png |= png;
+        request->svg |= svg;
+        ++writer->coalesced;
+    }
+    else 
+    {
+        request = &writer->queue[( writer->head + writer->length ) % SNAPSHOT_QUEUE_SIZE];
+        request->png = png;
+        request->svg = svg;
+        ++writer->length;
+    }
+
+    // The slot is reallocated whenever the genome changed its size, like
+    // when a polygon has been added in growth mode
+    if ( request->polygons != NULL 
+      && ( request->polygons->count != polygons->count || request->polygons->max_vertices != polygons->max_vertices ) ) 
+    {
+        free_polygons( request->polygons );
+        request->polygons = NULL;
+    }
+    if ( request->polygons == NULL ) 
+    {
+        request->polygons = copy_polygons( polygons );
+    }
+    else 
+    {
+        copy_polygons_into( request->polygons, polygons );
+    }
+    strncpy( request->name, name, sizeof( request->name ) - 1 );
+    request->name[sizeof( request->name ) - 1] = '\0';
+
+    pthread_cond_signal( &writer->wakeup );
+    pthread_mutex_unlock( &writer->lock );
+}
+
+void free_snapshot_writer( snapshot_writer_t* writer ) 
+{
+    int i;
+
+    // Let the thread drain the queue before it stops
+    pthread_mutex_lock( &writer->lock );
+    writer->running = 0;
+    pthread_cond_signal( &writer->wakeup );
+    pthread_mutex_unlock( &writer->lock );
+    pthread_join( writer->thread, NULL );
+
+    printf( "Snapshots: %llu written, %llu coalesced\n", writer->written, writer->coalesced );
+
+    for( i=0; i<SNAPSHOT_QUEUE_SIZE; ++i ) 
+    {
+        if ( writer->queue[i].polygons != NULL ) 
+        {
+            free_polygons( writer->queue[i].polygons );
+        }
+    }
+    if ( writer->working != NULL ) 
+    {
+        free_polygons( writer->working );
+    }
+    if ( writer->render_surface != NULL ) 
+    {
+        cairo_surface_destroy( writer->render_surface );
+    }
+    pthread_cond_destroy( &writer->wakeup );
+    pthread_mutex_destroy( &writer->lock );
+    free( writer );
+}
+
+void write_snapshot( cairo_surface_t* input, cairo_surface_t** render_surface, polygons_t* polygons, char* output_directory, char* name, int png, int svg ) 
+{
+    char* filename = malloc( sizeof( char ) * ( strlen( output_directory ) + strlen( name ) + 8 ) );
+    polygons_t* scaled = NULL;
+
+    // Polygons of a coarser pyramid level are written at the original
+    // resolution
+    if ( polygons->original_width != cairo_image_surface_get_width( input ) 
+      || polygons->original_height != cairo_image_surface_get_height( input ) ) 
+    {
+        scaled = copy_polygons( polygons );
+        scale_polygons( scaled, cairo_image_surface_get_width( input ), cairo_image_surface_get_height( input ) );
+        polygons = scaled;
+    }
+
+    if ( png ) 
+    {
+        reset_render_surface( input, render_surface, 1 );
+        render_polygons( *render_surface, polygons );
+        sprintf( filename, "%s/%s.png", output_directory, name );
+        cairo_surface_write_to_png( *render_surface, filename );
+        printf( "PNG: %s written.\n", filename );
+    }
+
+    if ( svg ) 
+    {
+        sprintf( filename, "%s/%s.svg", output_directory, name );
+        draw_polygons_to_svg( polygons, filename );
+        printf( "SVG: %s written.\n", filename );
+    }
+
+    if ( scaled != NULL ) 
+    {
+        free_polygons( scaled );
+    }
+    free( filename );
+}
+
+static void* run_snapshot_writer( void* data ) 
+{
+    snapshot_writer_t* writer = (snapshot_writer_t*)data;
+    snapshot_request_t request;
+
+    pthread_mutex_lock( &writer->lock );
+    while( 1 ) 
+    {
+        while( writer->length == 0 && writer->running ) 
+        {
+            pthread_cond_wait( &writer->wakeup, &writer->lock );
+        }
+        if ( writer->length == 0 ) 
+        {
+            break;
+        }
+
+        // Take over the queued polygons by swapping them with the working
+        // copy, which keeps the slot allocated for the next request
+        request = writer->queue[writer->head];
+        writer->queue[writer->head].polygons = writer->working;
+        writer->working = request.polygons;
+        writer->head = ( writer->head + 1 ) % SNAPSHOT_QUEUE_SIZE;
+        --writer->length;
+        pthread_mutex_unlock( &writer->lock );
+
+        write_snapshot( writer->input, &writer->render_surface, writer->working, writer->output_directory, request.name, request.png, request.svg );
+
+        pthread_mutex_lock( &writer->lock );
+        ++writer->written;
+    }
+    pthread_mutex_unlock( &writer->lock );
+
+    return NULL;
+}
@@ -0,0 +1,71 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <pthread.h>
+
+#include "polygon.h"
+
+#define SNAPSHOT_QUEUE_SIZE 4
+
+typedef struct snapshot_request 
+{
+    polygons_t* polygons;
+    char name[16];
+    int png;
+    int svg;
+} snapshot_request_t;
+
+// Background thread rendering and writing png and svg snapshots. The
+// annealing loop only copies the polygons into a bounded queue. If the queue
+// is full the newest pending request is replaced, so the most recent state
+// always reaches the disk.
+typedef struct snapshot_writer 
+{
+    cairo_surface_t* input;
+    cairo_surface_t* render_surface;
+    char* output_directory;
+
+    snapshot_request_t queue[SNAPSHOT_QUEUE_SIZE];
+    int head;
+    int length;
+
+    // Polygons currently rendered by the writer thread
+    polygons_t* working;
+
+    int running;
+    unsigned long long written;
+    unsigned long long coalesced;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+} snapshot_writer_t;
+
+snapshot_writer_t* initialize_snapshot_writer( cairo_surface_t* input, char* output_directory );
+
+void queue_snapshot( snapshot_writer_t* writer, polygons_t* polygons, char* name, int png, int svg );
+
+void free_snapshot_writer( snapshot_writer_t* writer );
+
+void write_snapshot( cairo_surface_t* input, cairo_surface_t** render_surface, polygons_t* polygons, char* output_directory, char* name, int png, int svg );
+
+#endif
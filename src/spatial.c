@@ -0,0 +1,293 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cairo.h>
+
+#include "polygon.h"
+#include "raster.h"
+#include "spatial.h"
+
+static int polygon_visible( spatial_t* spatial, polygons_t* polygons, int index );
+static void insert_polygon( spatial_t* spatial, int index );
+static void remove_polygon( spatial_t* spatial, int index );
+static void mark_bins( spatial_t* spatial, region_t* box, int index, int set );
+static void gather_polygons( spatial_t* spatial, polygons_t* polygons, region_t* region );
+
+spatial_t* initialize_spatial( int width, int height, polygons_t* polygons ) 
+{
+    int i;
+    spatial_t* spatial = malloc( sizeof( spatial_t ) * sizeof( char ) );
+
+    spatial->width      = width;
+    spatial->height     = height;
+    spatial->bin_width  = ( width + SPATIAL_BINS - 1 ) / SPATIAL_BINS;
+    spatial->bin_height = ( height + SPATIAL_BINS - 1 ) / SPATIAL_BINS;
+    spatial->count      = polygons->count;
+    spatial->words      = ( polygons->count + 63 ) / 64;
+    spatial->bins       = calloc( SPATIAL_BINS * SPATIAL_BINS * spatial->words, sizeof( unsigned long long int ) );
+    spatial->boxes      = malloc( sizeof( region_t ) * polygons->count );
+    spatial->visible    = malloc( sizeof( unsigned char ) * polygons->count );
+    spatial->invisible  = 0;
+    spatial->updated    = -1;
+    spatial->subset     = copy_polygons( polygons );
+    spatial->queried    = 0;
+    spatial->outside    = 0;
+    spatial->culled     = 0;
+
+    for( i=0; i<polygons->count; ++i ) 
+    {
+        spatial->visible[i] = polygon_visible( spatial, polygons, i );
+        if ( spatial->visible[i] ) 
+        {
+            polygons_bounding_box( polygons, i, width, height, &spatial->boxes[i] );
+        }
+        else 
+        {
+            spatial->boxes[i].x0 = spatial->boxes[i].x1 = 0;
+            spatial->boxes[i].y0 = spatial->boxes[i].y1 = 0;
+        }
+        insert_polygon( spatial, i );
+    }
+
+    return spatial;
+}
+
+void update_spatial( spatial_t* spatial, polygons_t* polygons, int index ) 
+{
+    // Remember the old entry and move the polygon to the bins of its new
+    // bounding box
+    spatial->updated         = index;
+    spatial->updated_box     = spatial->boxes[index];
+    spatial->updated_visible = spatial->visible[index];
+
+    remove_polygon( spatial, index );
+    spatial->visible[index] = polygon_visible( spatial, polygons, index );
+    if ( spatial->visible[index] ) 
+    {
+        polygons_bounding_box( polygons, index, spatial->width, spatial->height, &spatial->boxes[index] );
+    }
+    insert_polygon( spatial, index );
+}
+
+void revert_spatial( spatial_t* spatial ) 
+{
+    int index = spatial->updated;
+
+    if ( index < 0 ) 
+    {
+        return;
+    }
+    remove_polygon( spatial, index );
+    spatial->boxes[index]   = spatial->updated_box;
+    spatial->visible[index] = spatial->updated_visible;
+    insert_polygon( spatial, index );
+    spatial->updated = -1;
+}
+
+void render_spatial( spatial_t* spatial, cairo_surface_t* surface, polygons_t* polygons ) 
+{
+    region_t full;
+    full.x0 = 0;
+    full.y0 = 0;
+    full.x1 = spatial->width;
+    full.y1 = spatial->height;
+
+    gather_polygons( spatial, polygons, &full );
+    render_polygons( surface, spatial->subset );
+}
+
+void render_spatial_clipped( spatial_t* spatial, cairo_surface_t* surface, polygons_t* polygons, region_t* region ) 
+{
+    // The region is cleared even if no polygon overlaps it
+    gather_polygons( spatial, polygons, region );
+    render_polygons_clipped( surface, spatial->subset, region );
+}
+
+void print_spatial_statistics( spatial_t* spatial ) 
+{
+    if ( spatial->queried == 0 ) 
+    {
+        return;
+    }
+    printf( "Culling: %.2f%% of the polygon draws skipped outside the evaluated region, %.2f%% as invisible (%d invisible now)\n", 
+        100.0 * spatial->outside / spatial->queried,
+        100.0 * spatial->culled / spatial->queried,
+        spatial->invisible
+    );
+}
+
+void free_spatial( spatial_t* spatial ) 
+{
+    free( spatial->bins );
+    free( spatial->boxes );
+    free( spatial->visible );
+    free_polygons( spatial->subset );
+    free( spatial );
+}
+
+static int polygon_visible( spatial_t* spatial, polygons_t* polygons, int index ) 
+{
+    // A polygon is invisible if it is fully transparent, lies outside of
+    // the canvas or has no area at all, because every vertex is on the same
+    // line. Each of those provably leaves every pixel unchanged.
+    int vertices = polygons->vertices[index];
+    long long int x0 = POLYGON_X( polygons, index, 0 );
+    long long int y0 = POLYGON_Y( polygons, index, 0 );
+    long long int dx = 0, dy = 0;
+    int inside_x = 0, inside_y = 0;
+    int i;
+
+    if ( POLYGON_COLOR( polygons, index, 3 ) == 0 ) 
+    {
+        return 0;
+    }
+
+    for( i=0; i<vertices; ++i ) 
+    {
+        inside_x |= POLYGON_X( polygons, index, i ) < spatial->width;
+        inside_y |= POLYGON_Y( polygons, index, i ) < spatial->height;
+    }
+    if ( !inside_x || !inside_y ) 
+    {
+        return 0;
+    }
+
+    for( i=1; i<vertices; ++i ) 
+    {
+        long long int x = POLYGON_X( polygons, index, i ) - x0;
+        long long int y = POLYGON_Y( polygons, index, i ) - y0;
+        if ( dx == 0 && dy == 0 ) 
+        {
+            // First vertex apart from the initial one sets the direction
+            dx = x;
+            dy = y;
+        }
+        else if ( dx * y - dy * x != 0 ) 
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void insert_polygon( spatial_t* spatial, int index ) 
+{
+    if ( spatial->visible[index] ) 
+    {
+        mark_bins( spatial, &spatial->boxes[index], index, 1 );
+    }
+    else 
+    {
+        ++spatial->invisible;
+    }
+}
+
+static void remove_polygon( spatial_t* spatial, int index ) 
+{
+    if ( spatial->visible[index] ) 
+    {
+        mark_bins( spatial, &spatial->boxes[index], index, 0 );
+    }
+    else 
+    {
+        --spatial->invisible;
+    }
+}
+
+static void mark_bins( spatial_t* spatial, region_t* box, int index, int set ) 
+{
+    unsigned long long int bit = 1ULL << ( index % 64 );
+    int bx, by;
+    int bx0, by0, bx1, by1;
+
+    if ( box->x0 >= box->x1 || box->y0 >= box->y1 ) 
+    {
+        return;
+    }
+
+    bx0 = box->x0 / spatial->bin_width;
+    by0 = box->y0 / spatial->bin_height;
+    bx1 = ( box->x1 - 1 ) / spatial->bin_width;
+    by1 = ( box->y1 - 1 ) / spatial->bin_height;
+
+    for( by=by0; by<=by1; ++by ) 
+    {
+        for( bx=bx0; bx<=bx1; ++bx ) 
+        {
+            unsigned long long int* word = &spatial->bins[( by * SPATIAL_BINS + bx ) * spatial->words + index / 64];
+            *word = set ? *word | bit : *word & ~bit;
+        }
+    }
+}
+
+static void gather_polygons( spatial_t* spatial, polygons_t* polygons, region_t* region ) 
+{
+    int bx, by, w;
+    int bx0, by0, bx1, by1;
+    int count = 0;
+
+    spatial->queried += spatial->count;
+    spatial->culled  += spatial->invisible;
+
+    if ( region->x0 < region->x1 && region->y0 < region->y1 ) 
+    {
+        bx0 = region->x0 / spatial->bin_width;
+        by0 = region->y0 / spatial->bin_height;
+        bx1 = ( region->x1 - 1 ) / spatial->bin_width;
+        by1 = ( region->y1 - 1 ) / spatial->bin_height;
+        bx0 = bx0 < 0 ? 0 : bx0;
+        by0 = by0 < 0 ? 0 : by0;
+        bx1 = bx1 >= SPATIAL_BINS ? SPATIAL_BINS - 1 : bx1;
+        by1 = by1 >= SPATIAL_BINS ? SPATIAL_BINS - 1 : by1;
+
+        // Merge the bitsets of all bins overlapping the region word by word
+        // and take the polygons in drawing order
+        for( w=0; w<spatial->words; ++w ) 
+        {
+            unsigned long long int word = 0;
+            for( by=by0; by<=by1; ++by ) 
+            {
+                for( bx=bx0; bx<=bx1; ++bx ) 
+                {
+                    word |= spatial->bins[( by * SPATIAL_BINS + bx ) * spatial->words + w];
+                }
+            }
+            while( word != 0 ) 
+            {
+                int index = w * 64 + __builtin_ctzll( word );
+                region_t* box = &spatial->boxes[index];
+                word &= word - 1;
+
+                // Bins are coarser than the boxes
+                if ( box->x0 < region->x1 && box->x1 > region->x0 && box->y0 < region->y1 && box->y1 > region->y0 ) 
+                {
+                    copy_polygon( spatial->subset, count++, polygons, index );
+                }
+            }
+        }
+    }
+
+    spatial->outside      += spatial->count - spatial->invisible - count;
+    spatial->subset->count = count;
+    spatial->subset->original_width  = polygons->original_width;
+    spatial->subset->original_height = polygons->original_height;
+}
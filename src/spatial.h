@@ -0,0 +1,70 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+// Number of bins the canvas is split into along either axis
+#define SPATIAL_BINS 8
+
+// Bounding boxes of all polygons sorted into a grid of bins. Every bin
+// holds a bitset of the polygons overlapping it, so a region query yields
+// the polygons which may touch the region in drawing order. Polygons which
+// can not change any pixel are kept out of the bins altogether.
+typedef struct spatial 
+{
+    int width, height;
+    int bin_width, bin_height;
+    int count;
+    int words; // Bitset words per bin
+
+    unsigned long long int* bins;
+    region_t* boxes;         // Empty for invisible polygons
+    unsigned char* visible;
+    int invisible;
+
+    // Entry replaced by the last update, so a rejected mutation can be
+    // reverted
+    int updated;
+    region_t updated_box;
+    unsigned char updated_visible;
+
+    // Visible polygons overlapping the last query, drawn as a subset
+    polygons_t* subset;
+
+    // Polygons skipped by all queries so far, because they are outside of
+    // the queried region or provably invisible
+    unsigned long long int queried;
+    unsigned long long int outside;
+    unsigned long long int culled;
+} spatial_t;
+
+spatial_t* initialize_spatial( int width, int height, polygons_t* polygons );
+
+void update_spatial( spatial_t* spatial, polygons_t* polygons, int index );
+void revert_spatial( spatial_t* spatial );
+
+void render_spatial( spatial_t* spatial, cairo_surface_t* surface, polygons_t* polygons );
+void render_spatial_clipped( spatial_t* spatial, cairo_surface_t* surface, polygons_t* polygons, region_t* region );
+
+void print_spatial_statistics( spatial_t* spatial );
+
+void free_spatial( spatial_t* spatial );
+
+#endif
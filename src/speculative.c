@@ -0,0 +1,214 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include <cairo.h>
+
+#include "random.h"
+#include "polygon.h"
+#include "fitness.h"
+#include "raster.h"
+#include "spatial.h"
+#include "incremental.h"
+#include "bands.h"
+#include "layers.h"
+#include "screen.h"
+#include "chain.h"
+#include "speculative.h"
+
+typedef struct speculation_worker 
+{
+    speculation_t* speculation;
+    int index;
+} speculation_worker_t;
+
+static void* run_speculation_worker( void* argument );
+static void evaluate_candidate( speculation_t* speculation, int index );
+
+speculation_t* initialize_speculation( chain_t* chain, int count, double alpha ) 
+{
+    int i;
+    speculation_t* speculation = malloc( sizeof( speculation_t ) * sizeof( char ) );
+
+    speculation->chain     = chain;
+    speculation->count     = count;
+    speculation->alpha     = alpha;
+    speculation->running   = 1;
+    speculation->evaluated = 0;
+    speculation->consumed  = 0;
+
+    speculation->candidates = malloc( sizeof( polygons_t* ) * count );
+    speculation->surfaces   = malloc( sizeof( cairo_surface_t* ) * count );
+    speculation->fitness    = malloc( sizeof( unsigned long long int ) * count );
+    speculation->threads    = malloc( sizeof( pthread_t ) * count );
+
+    for( i=0; i<count; ++i ) 
+    {
+        speculation->candidates[i] = copy_polygons( chain->polygons );
+        speculation->surfaces[i]   = NULL;
+        reset_render_surface( chain->original, &speculation->surfaces[i], 0 );
+    }
+
+    // The calling thread evaluates the first candidate itself
+    pthread_barrier_init( &speculation->start, NULL, count );
+    pthread_barrier_init( &speculation->done, NULL, count );
+
+    for( i=1; i<count; ++i ) 
+    {
+        speculation_worker_t* worker = malloc( sizeof( speculation_worker_t ) * sizeof( char ) );
+        worker->speculation = speculation;
+        worker->index       = i;
+        if ( pthread_create( &speculation->threads[i], NULL, run_speculation_worker, worker ) != 0 ) 
+        {
+            printf( "Could not create speculation thread.\n" );
+            exit( EXIT_FAILURE );
+        }
+    }
+
+    return speculation;
+}
+
+int step_speculation( speculation_t* speculation ) 
+{
+    chain_t* chain = speculation->chain;
+    int i;
+
+    // Mutations are created serially, so the random sequence does not
+    // depend on the thread scheduling
+    for( i=0; i<speculation->count; ++i ) 
+    {
+        copy_polygons_into( speculation->candidates[i], chain->polygons );
+        evolve_polygons( speculation->candidates[i], NULL, &chain->random );
+    }
+
+    pthread_barrier_wait( &speculation->start );
+    evaluate_candidate( speculation, 0 );
+    pthread_barrier_wait( &speculation->done );
+
+    speculation->evaluated += speculation->count;
+
+    // Test the candidates in order, just like consecutive iterations. The
+    // temperature is lowered after every candidate which has been tested.
+    for( i=0; i<speculation->count; ++i ) 
+    {
+        unsigned long long int new_fitness = speculation->fitness[i];
+        int accepted = 0;
+
+        if ( new_fitness < chain->current_fitness ) 
+        {
+            ++chain->benefitial;
+            accepted = 1;
+        }
+        else 
+        {
+            double randval = rand_double( &chain->random );
+            long long int fitness_difference           = new_fitness - chain->current_fitness;
+            double fitness_temperature_division = ( fitness_difference / ( chain->temperature * 10.0 ) );
+            double pb                           = exp( (double)(-1) * fitness_temperature_division );            
+            if( randval < pb ) 
+            {
+                ++chain->annealing;
+                accepted = 1;
+            }
+        }
+
+        if ( accepted ) 
+        {
+            // Every later candidate is based on the replaced state and
+            // therefore discarded
+            polygons_t* previous = chain->polygons;
+            chain->polygons = speculation->candidates[i];
+            speculation->candidates[i] = previous;
+            chain->current_fitness = new_fitness;
+
+            if ( new_fitness <= chain->best_fitness ) 
+            {
+                copy_polygons_into( chain->best_polygons, chain->polygons );
+                chain->best_fitness = new_fitness;
+            }
+
+            speculation->consumed += i + 1;
+            return i + 1;
+        }
+
+        if ( i < speculation->count - 1 ) 
+        {
+            chain->temperature *= speculation->alpha;
+        }
+    }
+
+    speculation->consumed += speculation->count;
+    return speculation->count;
+}
+
+void free_speculation( speculation_t* speculation ) 
+{
+    int i;
+
+    speculation->running = 0;
+    pthread_barrier_wait( &speculation->start );
+    for( i=1; i<speculation->count; ++i ) 
+    {
+        pthread_join( speculation->threads[i], NULL );
+    }
+
+    pthread_barrier_destroy( &speculation->start );
+    pthread_barrier_destroy( &speculation->done );
+
+    for( i=0; i<speculation->count; ++i ) 
+    {
+        free_polygons( speculation->candidates[i] );
+        cairo_surface_destroy( speculation->surfaces[i] );
+    }
+    free( speculation->candidates );
+    free( speculation->surfaces );
+    free( speculation->fitness );
+    free( speculation->threads );
+    free( speculation );
+}
+
+static void* run_speculation_worker( void* argument ) 
+{
+    speculation_worker_t* worker = (speculation_worker_t*)argument;
+    speculation_t* speculation = worker->speculation;
+
+    while( 1 ) 
+    {
+        pthread_barrier_wait( &speculation->start );
+        if ( !speculation->running ) 
+        {
+            break;
+        }
+        evaluate_candidate( speculation, worker->index );
+        pthread_barrier_wait( &speculation->done );
+    }
+
+    free( worker );
+    return NULL;
+}
+
+static void evaluate_candidate( speculation_t* speculation, int index ) 
+{
+    reset_render_surface( speculation->chain->original, &speculation->surfaces[index], 1 );
+    render_polygons( speculation->surfaces[index], speculation->candidates[index] );
+    speculation->fitness[index] = quadratic_error( speculation->chain->original, speculation->surfaces[index] );
+}
@@ -0,0 +1,57 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef SPECULATIVE_H
+#define SPECULATIVE_H
+
+#include <pthread.h>
+
+#define SPECULATIVE_DEFAULT_COUNT 4
+
+// Speculative evaluation of a chain: A batch of independent mutations of
+// the current polygons is evaluated concurrently. The Metropolis test is
+// then applied in order and the first accepted candidate is taken, which
+// is statistically the same as proposing the candidates one by one.
+typedef struct speculation 
+{
+    chain_t* chain;
+    int count;
+    double alpha;
+
+    polygons_t** candidates;
+    cairo_surface_t** surfaces;
+    unsigned long long int* fitness;
+
+    pthread_t* threads;
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+    int running;
+
+    // Candidates evaluated and actually consumed by the chain
+    unsigned long long int evaluated;
+    unsigned long long int consumed;
+} speculation_t;
+
+speculation_t* initialize_speculation( chain_t* chain, int count, double alpha );
+
+int step_speculation( speculation_t* speculation );
+
+void free_speculation( speculation_t* speculation );
+
+#endif
@@ -0,0 +1,148 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "telemetry.h"
+
+static unsigned long long int telemetry_clock();
+
+telemetry_t* initialize_telemetry( char* filename, const char* format, double interval ) 
+{
+    telemetry_t* telemetry = malloc( sizeof( telemetry_t ) * sizeof( char ) );
+
+    if ( format == NULL || strcmp( format, "ndjson" ) == 0 ) 
+    {
+        telemetry->format = TELEMETRY_NDJSON;
+    }
+    else if ( strcmp( format, "csv" ) == 0 ) 
+    {
+        telemetry->format = TELEMETRY_CSV;
+    }
+    else 
+    {
+        printf( "Unknown telemetry format %s (ndjson or csv).\n", format );
+        exit( EXIT_FAILURE );
+    }
+
+    telemetry->file = NULL;
+    if ( filename != NULL ) 
+    {
+        // Line buffered, so pipes receive every record right away
+        if ( ( telemetry->file = fopen( filename, "w" ) ) == NULL ) 
+        {
+            printf( "Could not open telemetry file %s.\n", filename );
+            exit( EXIT_FAILURE );
+        }
+        setvbuf( telemetry->file, NULL, _IOLBF, 0 );
+
+        if ( telemetry->format == TELEMETRY_CSV ) 
+        {
+            fprintf( telemetry->file, "time,iteration,temperature,current_fitness,best_fitness,benefitial,annealing,benefitial_rate,annealing_rate,iterations_per_second\n" );
+        }
+    }
+
+    telemetry->interval  = (unsigned long long int)( interval * 1e9 );
+    telemetry->start     = telemetry_clock();
+    telemetry->next      = telemetry->start;
+    telemetry->last_time = telemetry->start;
+    memset( &telemetry->last, 0, sizeof( telemetry_sample_t ) );
+
+    return telemetry;
+}
+
+int telemetry_due( telemetry_t* telemetry ) 
+{
+    return telemetry_clock() >= telemetry->next;
+}
+
+void reset_telemetry( telemetry_t* telemetry, telemetry_sample_t* sample ) 
+{
+    // The next window starts at the given state, like the one of a resumed
+    // run
+    telemetry->last      = *sample;
+    telemetry->last_time = telemetry_clock();
+}
+
+void record_telemetry( telemetry_t* telemetry, telemetry_sample_t* sample ) 
+{
+    unsigned long long int now = telemetry_clock();
+    unsigned int iterations = sample->iteration >= telemetry->last.iteration ? sample->iteration - telemetry->last.iteration : 0;
+    double seconds = ( now - telemetry->last_time ) / 1e9;
+    double time = ( now - telemetry->start ) / 1e9;
+    double benefitial_rate = 0.0, annealing_rate = 0.0, speed = 0.0;
+
+    // Rates over the window since the previous record. Counters which went
+    // back belong to a replaced chain, the window has no valid rate then.
+    if ( iterations > 0 
+      && sample->benefitial >= telemetry->last.benefitial 
+      && sample->annealing >= telemetry->last.annealing ) 
+    {
+        benefitial_rate = (double)( sample->benefitial - telemetry->last.benefitial ) / iterations;
+        annealing_rate  = (double)( sample->annealing - telemetry->last.annealing ) / iterations;
+    }
+    if ( seconds > 0.0 ) 
+    {
+        speed = iterations / seconds;
+    }
+
+    if ( telemetry->file != NULL ) 
+    {
+        if ( telemetry->format == TELEMETRY_CSV ) 
+        {
+            fprintf( telemetry->file, "%.3f,%u,%.6f,%llu,%llu,%u,%u,%.6f,%.6f,%.1f\n",
+                time, sample->iteration, sample->temperature, sample->current_fitness, sample->best_fitness,
+                sample->benefitial, sample->annealing, benefitial_rate, annealing_rate, speed
+            );
+        }
+        else 
+        {
+            fprintf( telemetry->file, "{\"time\":%.3f,\"iteration\":%u,\"temperature\":%.6f,\"current_fitness\":%llu,\"best_fitness\":%llu,\"benefitial\":%u,\"annealing\":%u,\"benefitial_rate\":%.6f,\"annealing_rate\":%.6f,\"iterations_per_second\":%.1f}\n",
+                time, sample->iteration, sample->temperature, sample->current_fitness, sample->best_fitness,
+                sample->benefitial, sample->annealing, benefitial_rate, annealing_rate, speed
+            );
+        }
+    }
+
+    printf( "\r%u/%u/%u/%f (%llu) %.0f/s            ", sample->benefitial, sample->annealing, sample->iteration, sample->temperature, sample->best_fitness, speed );
+    fflush( stdout );
+
+    telemetry->last      = *sample;
+    telemetry->last_time = now;
+    telemetry->next      = now + telemetry->interval;
+}
+
+void free_telemetry( telemetry_t* telemetry ) 
+{
+    if ( telemetry->file != NULL ) 
+    {
+        fclose( telemetry->file );
+    }
+    free( telemetry );
+}
+
+static unsigned long long int telemetry_clock() 
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (unsigned long long int)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
@@ -0,0 +1,67 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#define TELEMETRY_DEFAULT_INTERVAL 0.5
+
+enum 
+{
+    TELEMETRY_NDJSON,
+    TELEMETRY_CSV
+};
+
+// State of a run at the time a record is taken
+typedef struct telemetry_sample 
+{
+    unsigned int iteration;
+    double temperature;
+    unsigned long long int current_fitness;
+    unsigned long long int best_fitness;
+    unsigned int benefitial;
+    unsigned int annealing;
+} telemetry_sample_t;
+
+// Progress records taken at a fixed wall time interval. Every record is
+// written to the telemetry file (if any) and shown on the terminal.
+typedef struct telemetry 
+{
+    FILE* file; // NULL if disabled
+    int format;
+    unsigned long long int interval; // Nanoseconds
+    unsigned long long int start;
+    unsigned long long int next;
+
+    // Previous record, the rates are calculated over the window since
+    unsigned long long int last_time;
+    telemetry_sample_t last;
+} telemetry_t;
+
+telemetry_t* initialize_telemetry( char* filename, const char* format, double interval );
+
+int telemetry_due( telemetry_t* telemetry );
+
+void reset_telemetry( telemetry_t* telemetry, telemetry_sample_t* sample );
+
+void record_telemetry( telemetry_t* telemetry, telemetry_sample_t* sample );
+
+void free_telemetry( telemetry_t* telemetry );
+
+#endif
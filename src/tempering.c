@@ -0,0 +1,255 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include <cairo.h>
+
+#include "random.h"
+#include "polygon.h"
+#include "spatial.h"
+#include "incremental.h"
+#include "bands.h"
+#include "layers.h"
+#include "screen.h"
+#include "chain.h"
+#include "tempering.h"
+
+typedef struct tempering_worker 
+{
+    tempering_t* tempering;
+    int index;
+} tempering_worker_t;
+
+static void* run_tempering_worker( void* argument );
+static void exchange_temperatures( tempering_t* tempering );
+
+tempering_t* initialize_tempering( cairo_surface_t* original, int count, int polygon_count, int min_vertices, int max_vertices, double temperature, double ladder, double alpha, int steps, rand_state_t* random, chain_options_t* options ) 
+{
+    int i;
+    tempering_t* tempering = malloc( sizeof( tempering_t ) * sizeof( char ) );
+
+    tempering->count   = count;
+    tempering->alpha   = alpha;
+    tempering->steps   = steps;
+    tempering->epoch   = 0;
+    tempering->running = 1;
+
+    rand_split( random, &tempering->random );
+
+    tempering->chains          = malloc( sizeof( chain_t* ) * count );
+    tempering->rung            = malloc( sizeof( int ) * count );
+    tempering->rung_steps      = calloc( count, sizeof( unsigned long long int ) );
+    tempering->rung_accepted   = calloc( count, sizeof( unsigned long long int ) );
+    tempering->swap_attempts   = calloc( count, sizeof( unsigned long long int ) );
+    tempering->swaps           = calloc( count, sizeof( unsigned long long int ) );
+    tempering->accepted_before = calloc( count, sizeof( unsigned int ) );
+    tempering->threads         = malloc( sizeof( pthread_t ) * count );
+
+    // The coldest replica follows the given schedule, every further rung
+    // is hotter by the ladder factor
+    for( i=0; i<count; ++i ) 
+    {
+        tempering->chains[i] = initialize_chain( 
+            original, 
+            initialize_polygons( original, polygon_count, min_vertices, max_vertices, random ), 
+            temperature * pow( ladder, i ), 
+            random,
+            options
+        );
+        tempering->rung[i] = i;
+    }
+
+    pthread_barrier_init( &tempering->start, NULL, count + 1 );
+    pthread_barrier_init( &tempering->done, NULL, count + 1 );
+
+    for( i=0; i<count; ++i ) 
+    {
+        tempering_worker_t* worker = malloc( sizeof( tempering_worker_t ) * sizeof( char ) );
+        worker->tempering = tempering;
+        worker->index     = i;
+        if ( pthread_create( &tempering->threads[i], NULL, run_tempering_worker, worker ) != 0 ) 
+        {
+            printf( "Could not create tempering thread.\n" );
+            exit( EXIT_FAILURE );
+        }
+    }
+
+    return tempering;
+}
+
+void run_tempering( tempering_t* tempering ) 
+{
+    int i;
+
+    // Let all replicas run their steps concurrently
+    pthread_barrier_wait( &tempering->start );
+    pthread_barrier_wait( &tempering->done );
+
+    for( i=0; i<tempering->count; ++i ) 
+    {
+        chain_t* chain = tempering->chains[tempering->rung[i]];
+        unsigned int accepted = chain->benefitial + chain->annealing;
+        tempering->rung_steps[i]    += tempering->steps;
+        tempering->rung_accepted[i] += accepted - tempering->accepted_before[tempering->rung[i]];
+        tempering->accepted_before[tempering->rung[i]] = accepted;
+    }
+
+    exchange_temperatures( tempering );
+    ++tempering->epoch;
+}
+
+chain_t* coldest_chain( tempering_t* tempering ) 
+{
+    return tempering->chains[tempering->rung[0]];
+}
+
+chain_t* best_chain( tempering_t* tempering ) 
+{
+    int i;
+    chain_t* best = tempering->chains[0];
+    for( i=1; i<tempering->count; ++i ) 
+    {
+        if ( tempering->chains[i]->best_fitness < best->best_fitness ) 
+        {
+            best = tempering->chains[i];
+        }
+    }
+    return best;
+}
+
+void measure_tempering( tempering_t* tempering ) 
+{
+    // The replicas are idle between two runs
+    int i;
+    for( i=0; i<tempering->count; ++i ) 
+    {
+        measure_chain( tempering->chains[i] );
+    }
+}
+
+void print_tempering_statistics( tempering_t* tempering ) 
+{
+    int i;
+    for( i=0; i<tempering->count; ++i ) 
+    {
+        chain_t* chain = tempering->chains[tempering->rung[i]];
+        printf( "Replica %2d: T=%f acceptance %6.2f%%", 
+            i,
+            chain->temperature,
+            tempering->rung_steps[i] == 0 ? 0.0 : 100.0 * tempering->rung_accepted[i] / tempering->rung_steps[i]
+        );
+        if ( i < tempering->count - 1 ) 
+        {
+            printf( " swaps %6.2f%%", 
+                tempering->swap_attempts[i] == 0 ? 0.0 : 100.0 * tempering->swaps[i] / tempering->swap_attempts[i]
+            );
+        }
+        printf( " (%llu)\n", chain->best_fitness );
+    }
+}
+
+void free_tempering( tempering_t* tempering ) 
+{
+    int i;
+
+    // Wake up the workers a last time to let them exit
+    tempering->running = 0;
+    pthread_barrier_wait( &tempering->start );
+    for( i=0; i<tempering->count; ++i ) 
+    {
+        pthread_join( tempering->threads[i], NULL );
+        free_chain( tempering->chains[i] );
+    }
+
+    pthread_barrier_destroy( &tempering->start );
+    pthread_barrier_destroy( &tempering->done );
+
+    free( tempering->chains );
+    free( tempering->rung );
+    free( tempering->rung_steps );
+    free( tempering->rung_accepted );
+    free( tempering->swap_attempts );
+    free( tempering->swaps );
+    free( tempering->accepted_before );
+    free( tempering->threads );
+    free( tempering );
+}
+
+static void* run_tempering_worker( void* argument ) 
+{
+    tempering_worker_t* worker = (tempering_worker_t*)argument;
+    tempering_t* tempering = worker->tempering;
+    chain_t* chain = tempering->chains[worker->index];
+    int i;
+
+    while( 1 ) 
+    {
+        pthread_barrier_wait( &tempering->start );
+        if ( !tempering->running ) 
+        {
+            break;
+        }
+
+        for( i=0; i<tempering->steps; ++i ) 
+        {
+            step_chain( chain );
+            chain->temperature *= tempering->alpha;
+        }
+
+        pthread_barrier_wait( &tempering->done );
+    }
+
+    free( worker );
+    return NULL;
+}
+
+static void exchange_temperatures( tempering_t* tempering ) 
+{
+    int i;
+
+    // Alternate between even and odd neighbour pairs, so every replica takes
+    // part in at most one exchange per phase
+    for( i=tempering->epoch % 2; i<tempering->count - 1; i += 2 ) 
+    {
+        chain_t* colder = tempering->chains[tempering->rung[i]];
+        chain_t* hotter = tempering->chains[tempering->rung[i + 1]];
+
+        // Metropolis criterion for exchanging two configurations, using the
+        // same energy scale as the acceptance test of the chains
+        double delta = ( 1.0 / ( colder->temperature * 10.0 ) - 1.0 / ( hotter->temperature * 10.0 ) )
+                     * ( (double)colder->current_fitness - (double)hotter->current_fitness );
+
+        ++tempering->swap_attempts[i];
+        if ( delta >= 0.0 || rand_double( &tempering->random ) < exp( delta ) ) 
+        {
+            double temperature = colder->temperature;
+            int replica        = tempering->rung[i];
+
+            colder->temperature = hotter->temperature;
+            hotter->temperature = temperature;
+            tempering->rung[i]     = tempering->rung[i + 1];
+            tempering->rung[i + 1] = replica;
+
+            ++tempering->swaps[i];
+        }
+    }
+}
@@ -0,0 +1,73 @@
+/* 
+ * This file is part of Evolving vectorization
+ * Copyright (C) 2008  Jakob Westhoff
+ * 
+ * Evolving vectorization is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3 of the License. 
+ * 
+ * Evolving vectorization is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ * Public License for more details. 
+ * 
+ * You should have received a copy of the GNU General Public License along with
+ * arbit; if not, write to the Free Software Foundation, Inc., 51 Franklin St,
+ * Fifth Floor, Boston, MA  02110-1301  USA 
+ * 
+ */
+
+#ifndef TEMPERING_H
+#define TEMPERING_H
+
+#include <pthread.h>
+
+#define TEMPERING_DEFAULT_LADDER 1.5
+#define TEMPERING_DEFAULT_STEPS  100
+
+// Parallel tempering: Every replica is an annealing chain running on its
+// own thread. The replicas are sorted into a ladder of temperatures, and
+// neighbouring rungs periodically try to exchange their temperatures.
+typedef struct tempering 
+{
+    int count;
+    chain_t** chains;
+
+    // Index of the replica holding each rung, coldest first
+    int* rung;
+
+    double alpha;
+    int steps; // Steps of every replica between two exchange phases
+    unsigned int epoch;
+
+    // Random stream of the exchange decisions
+    rand_state_t random;
+
+    // Statistics collected per rung. The swaps of a rung are the ones with
+    // its next hotter neighbour.
+    unsigned long long int* rung_steps;
+    unsigned long long int* rung_accepted;
+    unsigned long long int* swap_attempts;
+    unsigned long long int* swaps;
+    unsigned int* accepted_before;
+
+    pthread_t* threads;
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+    int running;
+} tempering_t;
+
+tempering_t* initialize_tempering( cairo_surface_t* original, int count, int polygon_count, int min_vertices, int max_vertices, double temperature, double ladder, double alpha, int steps, rand_state_t* random, chain_options_t* options );
+
+void run_tempering( tempering_t* tempering );
+
+chain_t* coldest_chain( tempering_t* tempering );
+chain_t* best_chain( tempering_t* tempering );
+
+void measure_tempering( tempering_t* tempering );
+
+void print_tempering_statistics( tempering_t* tempering );
+
+void free_tempering( tempering_t* tempering );
+
+#endif